@@ -0,0 +1,155 @@
+#include "../src/http_server/http_parser.h"
+#include "../src/http_server/http_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <regex>
+#include <string>
+#include <unordered_map>
+
+/*
+ * 请求解析器的对比测试：RegexParser为改写前HttpRequest中基于正则表达式的解析过程（逐行复制为std::string，
+ * 每行构造一次std::regex，请求头存入unordered_map），HttpParser为手写状态机、以string_view记录的解析器。
+ * 分别解析简单的GET、浏览器常见的GET与带大量Cookie的GET，统计每个请求的平均耗时与堆内存申请次数。
+ * HttpParser分别使用标量、SSE2、AVX2内核扫描请求头(CPU不支持的指令集跳过)。
+ */
+
+static std::atomic<size_t> g_allocs(0); // 统计全部堆内存申请
+
+void* operator new(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+/* 改写前的解析过程，只保留与解析相关的部分 */
+class RegexParser {
+public:
+    bool Parse(const char* begin, const char* end)
+    {
+        const char CRLF[] = "\r\n";
+        m_method = m_path = m_version = m_body = "";
+        m_header.clear();
+        int state = 0; // 0:请求行，1:请求头，2:请求体，3:完成
+        while (begin < end && state != 3) {
+            const char* lineEnd = std::search(begin, end, CRLF, CRLF + 2);
+            const std::string line(begin, lineEnd);
+            if (state == 0) {
+                std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+                std::smatch subMatch;
+                if (!regex_match(line, subMatch, patten)) {
+                    return false;
+                }
+                m_method = subMatch[1];
+                m_path = subMatch[2];
+                m_version = subMatch[3];
+                state = 1;
+            } else if (state == 1) {
+                std::regex patten("^([^:]*): ?(.*)$");
+                std::smatch subMatch;
+                if (regex_match(line, subMatch, patten)) {
+                    m_header[subMatch[1]] = subMatch[2];
+                } else {
+                    state = end - begin <= 2 ? 3 : 2;
+                }
+            } else {
+                m_body = line;
+                state = 3;
+            }
+            if (lineEnd == end) {
+                break;
+            }
+            begin = lineEnd + 2;
+        }
+        return true;
+    }
+
+    size_t HeaderCount() const { return m_header.size(); }
+
+private:
+    std::string m_method, m_path, m_version, m_body;
+    std::unordered_map<std::string, std::string> m_header;
+};
+
+static std::string CookieRequest()
+{
+    std::string req = "GET /css/style.css HTTP/1.1\r\nHost: localhost:8080\r\n"
+                      "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+                      "Accept: text/css,*/*;q=0.1\r\nAccept-Language: en-US,en;q=0.5\r\n"
+                      "Accept-Encoding: gzip, deflate, br\r\nConnection: keep-alive\r\nCookie: ";
+    for (int i = 0; i < 40; i++) {
+        req += "session_token_" + std::to_string(i) + "=a8f5f167f44f4964e6c998dee827110c4f5b2b4a; ";
+    }
+    req += "theme=dark\r\nCache-Control: max-age=0\r\n\r\n";
+    return req;
+}
+
+static size_t Headers(const RegexParser& parser) { return parser.HeaderCount(); }
+static size_t Headers(const HttpParser& parser) { return parser.HeaderCount(); }
+
+template <typename T>
+static void Bench(const char* name, const char* reqName, const std::string& req, int n)
+{
+    T parser;
+    parser.Parse(req.data(), req.data() + req.size()); // 预热，复用的容器在此分配好
+    size_t allocs = g_allocs.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        if (!parser.Parse(req.data(), req.data() + req.size())) {
+            printf("%s: parse %s failed!\n", name, reqName);
+            return;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+    double allocPerReq = static_cast<double>(g_allocs.load() - allocs) / n;
+    printf("%-12s %-8s %6zu %8zu %12.1f %12.2f\n", name, reqName, req.size(), Headers(parser), ns, allocPerReq);
+}
+
+int main()
+{
+    const std::string simple = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+    const std::string browser = "GET /images/profile-image.jpg HTTP/1.1\r\nHost: localhost:8080\r\n"
+                                "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+                                "Accept: image/avif,image/webp,*/*\r\nAccept-Language: en-US,en;q=0.5\r\n"
+                                "Accept-Encoding: gzip, deflate, br\r\nConnection: keep-alive\r\n"
+                                "Referer: http://localhost:8080/picture.html\r\nSec-Fetch-Dest: image\r\n"
+                                "Sec-Fetch-Mode: no-cors\r\nSec-Fetch-Site: same-origin\r\n\r\n";
+    const std::string cookie = CookieRequest();
+
+    const struct {
+        HttpScan::Isa isa;
+        const char* name;
+    } isas[] = { { HttpScan::ISA_SCALAR, "state-scalar" }, { HttpScan::ISA_SSE2, "state-sse2" }, { HttpScan::ISA_AVX2, "state-avx2" } };
+    const struct {
+        const char* name;
+        const std::string& req;
+        int regexRounds;
+    } reqs[] = { { "simple", simple, 2000 }, { "browser", browser, 500 }, { "cookie", cookie, 200 } };
+
+    printf("%-12s %-8s %6s %8s %12s %12s\n", "parser", "request", "bytes", "headers", "ns/request", "allocs/req");
+    for (auto& req : reqs) {
+        Bench<RegexParser>("regex", req.name, req.req, req.regexRounds);
+        for (auto& isa : isas) {
+            if (HttpScan::SetIsa(isa.isa) == isa.isa) {
+                Bench<HttpParser>(isa.name, req.name, req.req, req.regexRounds * 500);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/http_server/epoll.h"
+#include "../src/http_server/uring.h"
+
+/*
+ * epoll与io_uring两种事件后端在长连接请求上的系统调用次数对比，服务端的过程与Reactor相同：
+ * 等待事件，readv读到EAGAIN，writev写出应答，试探性地再readv一次(EAGAIN)，然后重新注册EPOLLIN。
+ * oneshot：默认模式，每个请求结束时ModFd重新注册；affinity：conn_affinity模式，注册一次，此后不再修改。
+ * 客户端在另一个进程中，每轮向所有连接各发一个请求再逐个读取应答。
+ * 服务端进程被ptrace跟踪，按系统调用号分类计数；耗时在不跟踪时另跑一遍得到。
+ */
+
+static const char REQUEST[] = "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: keep-alive\r\n\r\n";
+static const char RESPONSE[] = "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nContent-Length: 2\r\n\r\nok";
+static const size_t REQUEST_LEN = sizeof(REQUEST) - 1;
+static const size_t RESPONSE_LEN = sizeof(RESPONSE) - 1;
+
+/* 与内核struct ptrace_syscall_info在系统调用入口时的布局相同，linux/ptrace.h与sys/ptrace.h不能同时包含 */
+struct SyscallEntry {
+    uint8_t op; // 1代表系统调用入口
+    uint8_t pad[3];
+    uint32_t arch;
+    uint64_t instruction_pointer;
+    uint64_t stack_pointer;
+    uint64_t nr;
+    uint64_t args[6];
+};
+
+struct Counts {
+    long wait = 0; // epoll_wait、io_uring_enter
+    long ctl = 0; // epoll_ctl
+    long read = 0;
+    long write = 0;
+    long other = 0;
+};
+
+static std::unique_ptr<Poller> MakePoller(bool uring)
+{
+    if (uring) {
+        auto poller = std::make_unique<IoUring>();
+        if (!poller->IsValid()) {
+            return nullptr;
+        }
+        return poller;
+    }
+    return std::make_unique<Epoll>();
+}
+
+/**
+ * 服务端：处理fds上的conns * rounds个请求后返回，trace为true时在注册完成后停下等待跟踪
+ */
+static int Server(const std::vector<int>& fds, bool uring, bool oneshot, long total, bool trace)
+{
+    std::unique_ptr<Poller> poller = MakePoller(uring);
+    if (!poller) {
+        return 2;
+    }
+    uint32_t base = EPOLLIN | EPOLLET | EPOLLRDHUP | (oneshot ? EPOLLONESHOT : EPOLLOUT);
+    std::vector<size_t> pending(fds.size(), 0); // 各连接已读到但还未应答的字节数
+    for (size_t i = 0; i < fds.size(); i++) {
+        poller->AddFd(fds[i], base, reinterpret_cast<void*>(i));
+    }
+    if (trace) {
+        raise(SIGSTOP); // 只统计注册之后的系统调用
+    }
+    char buf[4096];
+    long served = 0;
+    while (served < total) {
+        int cnt = poller->Wait(-1);
+        for (int e = 0; e < cnt; e++) {
+            size_t i = reinterpret_cast<size_t>(poller->GetEventData(e));
+            if (!(poller->GetEvents(e) & EPOLLIN)) {
+                continue;
+            }
+            bool again = true;
+            while (again) {
+                ssize_t len;
+                struct iovec iov = { buf, sizeof(buf) };
+                while ((len = readv(fds[i], &iov, 1)) > 0) { // ET模式读到EAGAIN
+                    pending[i] += len;
+                }
+                if (len == 0) {
+                    return 3;
+                }
+                again = false;
+                while (pending[i] >= REQUEST_LEN) {
+                    struct iovec out = { const_cast<char*>(RESPONSE), RESPONSE_LEN };
+                    if (writev(fds[i], &out, 1) != static_cast<ssize_t>(RESPONSE_LEN)) {
+                        return 4;
+                    }
+                    pending[i] -= REQUEST_LEN;
+                    served++;
+                    again = true; // 写完后试探性地读取下一个请求
+                }
+            }
+            if (oneshot) {
+                poller->ModFd(fds[i], base, reinterpret_cast<void*>(i));
+            }
+        }
+    }
+    return 0;
+}
+
+static void Client(const std::vector<int>& fds, int rounds)
+{
+    char buf[4096];
+    for (int r = 0; r < rounds; r++) {
+        for (int fd : fds) {
+            if (write(fd, REQUEST, REQUEST_LEN) != static_cast<ssize_t>(REQUEST_LEN)) {
+                _exit(1);
+            }
+        }
+        for (int fd : fds) {
+            size_t got = 0;
+            while (got < RESPONSE_LEN) {
+                ssize_t len = read(fd, buf, RESPONSE_LEN - got);
+                if (len <= 0) {
+                    _exit(1);
+                }
+                got += len;
+            }
+        }
+    }
+    _exit(0);
+}
+
+static void Classify(Counts& counts, long nr)
+{
+    switch (nr) {
+    case SYS_epoll_wait:
+    case SYS_epoll_pwait:
+    case SYS_io_uring_enter:
+        counts.wait++;
+        break;
+    case SYS_epoll_ctl:
+        counts.ctl++;
+        break;
+    case SYS_read:
+    case SYS_readv:
+    case SYS_recvfrom:
+        counts.read++;
+        break;
+    case SYS_write:
+    case SYS_writev:
+    case SYS_sendto:
+        counts.write++;
+        break;
+    default:
+        counts.other++;
+    }
+}
+
+/**
+ * 跑一遍conns个连接、rounds轮的长连接请求，trace为true时统计服务端的系统调用，返回耗时(ms)，失败时返回负数
+ */
+static double Run(bool uring, bool oneshot, int conns, int rounds, bool trace, Counts& counts)
+{
+    std::vector<int> server_fds, client_fds;
+    for (int i = 0; i < conns; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            perror("socketpair");
+            exit(1);
+        }
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+        server_fds.push_back(sv[0]);
+        client_fds.push_back(sv[1]);
+    }
+    auto start = std::chrono::steady_clock::now();
+    pid_t server = fork();
+    if (server == 0) {
+        if (trace) {
+            ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
+        }
+        _exit(Server(server_fds, uring, oneshot, static_cast<long>(conns) * rounds, trace));
+    }
+    int status = 0;
+    if (trace) { // 服务端注册完成后停下，此后在每个系统调用入口停下计数
+        waitpid(server, &status, 0);
+        ptrace(PTRACE_SETOPTIONS, server, nullptr, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL);
+        ptrace(PTRACE_SYSCALL, server, nullptr, nullptr);
+    }
+    pid_t client = fork();
+    if (client == 0) {
+        Client(client_fds, rounds);
+    }
+    for (int fd : server_fds) {
+        close(fd);
+    }
+    for (int fd : client_fds) {
+        close(fd);
+    }
+    while (waitpid(server, &status, 0) > 0 && !WIFEXITED(status) && !WIFSIGNALED(status)) {
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+            SyscallEntry info;
+            if (ptrace(PTRACE_GET_SYSCALL_INFO, server, sizeof(info), &info) > 0 && info.op == 1) {
+                Classify(counts, static_cast<long>(info.nr));
+            }
+        }
+        ptrace(PTRACE_SYSCALL, server, nullptr, nullptr);
+    }
+    int client_status = 0;
+    waitpid(client, &client_status, 0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !WIFEXITED(client_status) || WEXITSTATUS(client_status) != 0) {
+        return -1;
+    }
+    return ms;
+}
+
+int main(int argc, char* argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 64;
+    int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+    printf("%d connections x %d keep-alive requests, server side syscalls per request\n", conns, rounds);
+    printf("%-10s %-8s %8s %8s %8s %8s %8s %8s %10s\n", "backend", "mode", "wait", "ctl", "read", "write", "other", "total", "us/req");
+    for (bool oneshot : { true, false }) {
+        for (bool uring : { false, true }) {
+            Counts counts;
+            double traced = Run(uring, oneshot, conns, rounds, true, counts);
+            Counts unused;
+            double ms = Run(uring, oneshot, conns, rounds, false, unused);
+            if (traced < 0 || ms < 0) {
+                printf("%-10s %-8s failed (io_uring unavailable?)\n", uring ? "io_uring" : "epoll", oneshot ? "oneshot" : "affinity");
+                continue;
+            }
+            double n = static_cast<double>(conns) * rounds;
+            long total = counts.wait + counts.ctl + counts.read + counts.write + counts.other;
+            printf("%-10s %-8s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %10.3f\n", uring ? "io_uring" : "epoll", oneshot ? "oneshot" : "affinity",
+                counts.wait / n, counts.ctl / n, counts.read / n, counts.write / n, counts.other / n, total / n, ms * 1000 / n);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+
+/*
+ * 静态文件两种发送方式的对比测试，与HttpResponse::AddContent、HttpConnector::Write的过程相同：
+ * mmap：每个请求open、mmap、close，writev写出头部与映射的文件，写完后munmap；
+ * sendfile：每个请求open，头部用send(MSG_MORE)，文件内容用sendfile从页缓存直接发送，写完后close。
+ * 在本机TCP连接上分别发送4KB、64KB、1MB、16MB的文件，另一个线程只负责接收，统计每个请求的耗时与发送线程的缺页次数。
+ */
+
+static std::atomic<size_t> g_received(0);
+
+static void Receiver(int fd)
+{
+    static char buf[1 << 20];
+    while (true) {
+        ssize_t len = recv(fd, buf, sizeof(buf), 0);
+        if (len <= 0) {
+            return;
+        }
+        g_received.fetch_add(len, std::memory_order_relaxed);
+    }
+}
+
+static std::string MakeFile(size_t size)
+{
+    char path[] = "/tmp/sendfile_bench_XXXXXX";
+    int fd = mkstemp(path);
+    std::string block(64 * 1024, 'x');
+    for (size_t left = size; left > 0;) {
+        size_t len = std::min(left, block.size());
+        if (write(fd, block.data(), len) != static_cast<ssize_t>(len)) {
+            perror("write");
+            exit(1);
+        }
+        left -= len;
+    }
+    close(fd);
+    return path;
+}
+
+static std::string Head(size_t size)
+{
+    return "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\nkeep-alive: max=6, timeout=120\r\nContent-type: text/plain\r\n"
+           "Content-length: "
+        + std::to_string(size) + "\r\n\r\n";
+}
+
+static size_t SendMmap(int sock, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    void* file = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    std::string head = Head(st.st_size);
+    struct iovec iov[2] = { { &head[0], head.size() }, { file, static_cast<size_t>(st.st_size) } };
+    size_t total = head.size() + st.st_size;
+    for (size_t sent = 0, pos = 0; sent < total;) {
+        ssize_t len = writev(sock, iov + pos, 2 - pos);
+        if (len <= 0) {
+            perror("writev");
+            exit(1);
+        }
+        sent += len;
+        for (size_t written = len; written > 0;) { // 与HttpConnector::Write相同，跳过已写完的iovec
+            if (written < iov[pos].iov_len) {
+                iov[pos].iov_base = static_cast<char*>(iov[pos].iov_base) + written;
+                iov[pos].iov_len -= written;
+                break;
+            }
+            written -= iov[pos++].iov_len;
+        }
+    }
+    munmap(file, st.st_size);
+    return total;
+}
+
+static size_t SendFile(int sock, const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    std::string head = Head(st.st_size);
+    for (size_t sent = 0; sent < head.size();) {
+        ssize_t len = send(sock, head.data() + sent, head.size() - sent, MSG_MORE);
+        if (len <= 0) {
+            perror("send");
+            exit(1);
+        }
+        sent += len;
+    }
+    for (off_t offset = 0; offset < st.st_size;) {
+        if (sendfile(sock, fd, &offset, st.st_size - offset) <= 0) {
+            perror("sendfile");
+            exit(1);
+        }
+    }
+    close(fd);
+    return head.size() + st.st_size;
+}
+
+static void Bench(const char* name, size_t (*send)(int, const char*), int sock, const std::string& path, size_t size, int n)
+{
+    size_t expect = g_received.load() + send(sock, path.c_str()); // 预热页缓存
+    while (g_received.load() < expect) { }
+    expect += (Head(size).size() + size) * n;
+    struct rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < n; i++) {
+        total += send(sock, path.c_str());
+    }
+    while (g_received.load() < expect) { } // 等待对端收完
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    getrusage(RUSAGE_THREAD, &after);
+    double faults = static_cast<double>(after.ru_minflt - before.ru_minflt) / n;
+    printf("%-9s %9zu %8d %12.1f %10.0f %12.1f\n", name, size, n, us / n, total / us, faults);
+}
+
+int main()
+{
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listenFd, 1) < 0) {
+        perror("listen");
+        return 1;
+    }
+    getsockname(listenFd, reinterpret_cast<sockaddr*>(&addr), &addrLen);
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("connect");
+        return 1;
+    }
+    int sock = accept(listenFd, nullptr, nullptr);
+    std::thread receiver(Receiver, client);
+
+    const struct {
+        size_t size;
+        int n;
+    } files[] = { { 4 * 1024, 20000 }, { 64 * 1024, 5000 }, { 1024 * 1024, 500 }, { 16 * 1024 * 1024, 30 } };
+    printf("%-9s %9s %8s %12s %10s %12s\n", "mode", "bytes", "requests", "us/request", "MB/s", "faults/req");
+    for (auto& file : files) {
+        std::string path = MakeFile(file.size);
+        Bench("mmap", SendMmap, sock, path, file.size, file.n);
+        Bench("sendfile", SendFile, sock, path, file.size, file.n);
+        unlink(path.c_str());
+    }
+    shutdown(sock, SHUT_WR);
+    receiver.join();
+    close(sock);
+    close(client);
+    close(listenFd);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "../src/utils/time_wheel.h"
+#include "../src/utils/timer.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+/*
+ * 时间堆HeapTimer与时间轮TimeWheel的对比测试，分别在1万、10万、100万个定时器下统计：
+ * add：添加全部定时器；adjust：每个定时器调整一次（模拟每次读写时的ExtentTime）；
+ * GetNextTick：无超时时调用同样次数（模拟每次事件循环）；expire：全部超时后一次tick执行全部回调。
+ */
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename T>
+static void Bench(const char* name, int n)
+{
+    std::mt19937 rng(n);
+    std::uniform_int_distribution<int> longTimeout(30000, 90000); // 长连接的超时时间
+    std::uniform_int_distribution<int> shortTimeout(0, 9);
+    T timer;
+    size_t fired = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        timer.add(i, longTimeout(rng), [&fired] { fired++; });
+    }
+    double addMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        timer.adjust(static_cast<int>(rng() % n), longTimeout(rng));
+    }
+    double adjustMs = ElapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        timer.GetNextTick();
+    }
+    double tickMs = ElapsedMs(start);
+
+    for (int i = 0; i < n; i++) { // 全部改为10ms内超时
+        timer.adjust(i, shortTimeout(rng));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    start = std::chrono::steady_clock::now();
+    timer.tick();
+    double expireMs = ElapsedMs(start);
+
+    printf("%-10s %8d %10.2f %10.2f %12.2f %10.2f %s\n", name, n, addMs, adjustMs, tickMs, expireMs,
+        fired == static_cast<size_t>(n) ? "" : "(not all expired!)");
+}
+
+int main()
+{
+    printf("%-10s %8s %10s %10s %12s %10s\n", "timer", "n", "add(ms)", "adjust(ms)", "nexttick(ms)", "expire(ms)");
+    for (int n : { 10000, 100000, 1000000 }) {
+        Bench<HeapTimer>("heap", n);
+        Bench<TimeWheel>("wheel", n);
+    }
+    return 0;
+}
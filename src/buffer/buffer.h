@@ -87,6 +87,16 @@ public:
         assert(len <= WriteableBytes());
         m_write_pos += len;
     }
+    /**
+     * 删除未读数据中从offset起的len个字节，其后的数据前移，用于从读缓冲中取走中间的一段(如写入临时文件的请求体)
+     */
+    void Erase(size_t offset, size_t len)
+    {
+        assert(offset + len <= ReadableBytes());
+        char* dst = GetReadPtr() + offset;
+        memmove(dst, dst + len, ReadableBytes() - offset - len);
+        m_write_pos -= len;
+    }
     /**
      * 从fd向缓冲区中写入数据
      */
@@ -106,6 +116,12 @@ public:
         std::copy(str.data(), str.data() + str.length(), GetWritePtr());
         AddWritePos(str.length());
     }
+    void Append(const char* data, size_t len)
+    {
+        EnsureWriteable(len);
+        memcpy(GetWritePtr(), data, len);
+        AddWritePos(len);
+    }
 
 private: // 成员函数
     /**
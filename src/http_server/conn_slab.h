@@ -0,0 +1,71 @@
+#ifndef _CONN_SLAB_H_
+#define _CONN_SLAB_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "http_connector.h"
+
+/**
+ * 以fd为下标的连接槽表，代替哈希表：事件分发时直接按fd取槽，不需要哈希查找。所有Reactor共享一张表（fd在进程内唯一）。
+ * 槽在构造时一次分配好，HttpConnector在fd第一次出现时创建，之后随fd复用而复用，不再释放。
+ * 每个槽带有代数，连接关闭时递增。交给线程池的任务、定时器回调在创建时记下代数，执行时代数不一致说明连接已关闭（fd可能已被复用），应直接丢弃。
+ * 代数只能丢弃尚未开始的工作：工作线程正在处理的连接标记为busy，Reactor::CloseConn对busy的连接只标记待关闭，
+ * 处理完成后才递增代数、关闭fd，因此工作线程持有的槽不会被复用或重新Init。
+ */
+class ConnSlab {
+public:
+    explicit ConnSlab(int max_fd)
+        : m_slots(max_fd)
+    {
+        assert(max_fd > 0);
+    }
+    ~ConnSlab() = default;
+
+    /**
+     * 取出fd对应的连接，槽为空时创建；只应由管理该fd的Reactor线程调用
+     */
+    HttpConnector* Get(int fd)
+    {
+        assert(fd >= 0 && fd < Capacity());
+        Slot& slot = m_slots[fd];
+        if (!slot.conn) {
+            slot.conn = std::make_unique<HttpConnector>();
+        }
+        return slot.conn.get();
+    }
+    /**
+     * fd对应槽的当前代数
+     */
+    uint32_t GetGen(int fd) const
+    {
+        assert(fd >= 0 && fd < Capacity());
+        return m_slots[fd].gen.load(std::memory_order_acquire);
+    }
+    /**
+     * 判断之前记下的代数是否仍然有效
+     */
+    bool IsCurrent(int fd, uint32_t gen) const { return GetGen(fd) == gen; }
+    /**
+     * 连接关闭时调用，递增代数，使之前记下代数的任务、定时器失效
+     */
+    void Retire(int fd)
+    {
+        assert(fd >= 0 && fd < Capacity());
+        m_slots[fd].gen.fetch_add(1, std::memory_order_acq_rel);
+    }
+    int Capacity() const { return static_cast<int>(m_slots.size()); }
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> gen { 0 }; // 槽的代数
+        std::unique_ptr<HttpConnector> conn; // 槽中的连接
+    };
+
+    std::vector<Slot> m_slots;
+};
+
+#endif // _CONN_SLAB_H_
@@ -8,7 +8,12 @@
 #include <unistd.h>
 #include <vector>
 
-class Epoll {
+#include "poller.h"
+
+/**
+ * epoll后端
+ */
+class Epoll : public Poller {
 public:
     explicit Epoll(int maxEvent = 1024, bool is_ET = true)
         : m_epfd(epoll_create(512))
@@ -18,32 +23,32 @@ public:
         assert(m_epfd >= 0 && m_events.size() > 0);
     }
 
-    ~Epoll() { close(m_epfd); }
+    ~Epoll() override { close(m_epfd); }
 
     /**
      * 向epoll事件表注册事件
      */
-    bool AddFd(int fd, uint32_t events);
+    bool AddFd(int fd, uint32_t events, void* data) override;
     /**
      * 修改已经注册的fd的监听事件
      */
-    bool ModFd(int fd, uint32_t events);
+    bool ModFd(int fd, uint32_t events, void* data) override;
     /**
      * 从epoll事件表中删除一个fd
      */
-    bool DelFd(int fd);
+    bool DelFd(int fd) override;
     /**
      * 等待epoll上监听的fd产生事件，超时时间timeout，产生的事件需要使用GetEvents获得
      */
-    int Wait(int timeout = -1);
+    int Wait(int timeout = -1) override;
     /**
-     * 获取产生的事件的来源fd（应在wait之后调用）
+     * 获取产生的事件的来源fd注册时的句柄（应在wait之后调用）
      */
-    int GetEventFd(size_t i) const;
+    void* GetEventData(size_t i) const override;
     /**
      *  获取产生的事件（应在wait之后调用）
      */
-    uint32_t GetEvents(size_t i) const;
+    uint32_t GetEvents(size_t i) const override;
 
 private:
     bool m_is_ET; // 是否开启ET模式
@@ -0,0 +1,134 @@
+#include "file_cache.h"
+#include "../utils/coarse_clock.h"
+#include "../utils/log.h"
+#include "http_response.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <sys/mman.h>
+#include <unistd.h>
+
+size_t FileCache::g_max_entries = 256;
+int64_t FileCache::g_validate_ms = 1000;
+
+FileCache::Entry::~Entry()
+{
+    if (map) {
+        munmap(map, st.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+FileCache::EntryPtr FileCache::Get(const std::string& path, bool map)
+{
+    int64_t now = CoarseClock::NowMs();
+    Shard& shard = m_shards[std::hash<std::string>()(path) % SHARD_NUM];
+    EntryPtr entry;
+    if (g_max_entries > 0) {
+        std::shared_lock<std::shared_mutex> locker(shard.mtx);
+        auto it = shard.entries.find(path);
+        if (it != shard.entries.end()) {
+            entry = it->second;
+        }
+    }
+    if (entry) {
+        if (entry->used_ms.load(std::memory_order_relaxed) != now) { // 粗粒度时间，同一时刻的命中不重复写
+            entry->used_ms.store(now, std::memory_order_relaxed);
+        }
+        if (now - entry->checked_ms.load(std::memory_order_relaxed) < g_validate_ms) { // 仍在校验间隔内，不访问文件系统
+            return entry->found ? entry : nullptr;
+        }
+        struct stat st;
+        bool found = stat(path.data(), &st) == 0 && !S_ISDIR(st.st_mode);
+        if (found == entry->found && (!found || SameFile(entry->st, st))) {
+            entry->checked_ms.store(now, std::memory_order_relaxed);
+            return entry->found ? entry : nullptr;
+        }
+    }
+
+    EntryPtr fresh = Load(path, map, now);
+    if (g_max_entries > 0) {
+        std::unique_lock<std::shared_mutex> locker(shard.mtx);
+        auto it = shard.entries.find(path);
+        if (it != shard.entries.end()) {
+            if (it->second != entry) { // 其他线程已经重新打开过，使用它的条目
+                fresh = it->second;
+            } else {
+                it->second = fresh;
+            }
+        } else {
+            size_t shardMax = std::max<size_t>(1, (g_max_entries + SHARD_NUM - 1) / SHARD_NUM);
+            if (shard.entries.size() >= shardMax) { // 淘汰最久未使用的条目，正在写出的连接仍持有其引用
+                auto oldest = std::min_element(shard.entries.begin(), shard.entries.end(), [](const auto& a, const auto& b) {
+                    return a.second->used_ms.load(std::memory_order_relaxed) < b.second->used_ms.load(std::memory_order_relaxed);
+                });
+                shard.entries.erase(oldest);
+            }
+            shard.entries.emplace(path, fresh);
+        }
+    } // 不缓存时条目随最后一个引用释放
+    return fresh->found ? fresh : nullptr;
+}
+
+FileCache::EntryPtr FileCache::Load(const std::string& path, bool map, int64_t now)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->path = path;
+    entry->mime = HttpResponse::GetFileType(path);
+    entry->checked_ms.store(now, std::memory_order_relaxed);
+    entry->used_ms.store(now, std::memory_order_relaxed);
+    /* 先打开再fstat，状态与映射描述的总是同一个文件，即使路径在两次调用之间被替换 */
+    entry->fd = open(path.data(), O_RDONLY);
+    if (entry->fd >= 0) {
+        entry->found = fstat(entry->fd, &entry->st) == 0 && !S_ISDIR(entry->st.st_mode);
+        if (!entry->found) {
+            close(entry->fd);
+            entry->fd = -1;
+        }
+    } else { // 打不开时区分无权限(403)与不存在(404)
+        entry->found = stat(path.data(), &entry->st) == 0 && !S_ISDIR(entry->st.st_mode);
+    }
+    if (entry->fd < 0) {
+        return entry;
+    }
+    /* MAP_PRIVATE 建立一个写入时拷贝的私有映射，映射只读，由所有连接共享；sendfile模式下直接使用fd，不需要映射 */
+    if (map && entry->st.st_size > 0) {
+        void* addr = mmap(nullptr, entry->st.st_size, PROT_READ, MAP_PRIVATE, entry->fd, 0);
+        if (addr != MAP_FAILED) {
+            entry->map = static_cast<char*>(addr);
+        }
+    }
+    LOG_DEBUG("file cache load %s", path.data());
+    return entry;
+}
+
+bool FileCache::SameFile(const struct stat& a, const struct stat& b)
+{
+    return a.st_ino == b.st_ino && a.st_dev == b.st_dev && a.st_size == b.st_size && a.st_mode == b.st_mode
+        && a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+std::string FileCache::Normalize(const std::string& path)
+{
+    std::string out;
+    out.reserve(path.size());
+    size_t i = 0;
+    while (i < path.size()) {
+        while (i < path.size() && path[i] == '/') {
+            i++;
+        }
+        size_t end = std::min(path.find('/', i), path.size());
+        size_t len = end - i;
+        if (len == 2 && path[i] == '.' && path[i + 1] == '.') { // 回退一级，已在根目录时忽略
+            out.erase(out.empty() ? 0 : out.find_last_of('/'));
+        } else if (len > 0 && !(len == 1 && path[i] == '.')) {
+            out += '/';
+            out.append(path, i, len);
+        }
+        i = end;
+    }
+    return out.empty() ? "/" : out;
+}
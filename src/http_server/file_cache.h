@@ -0,0 +1,80 @@
+#ifndef _FILE_CACHE_H_
+#define _FILE_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+/**
+ * 所有连接共享的静态文件缓存：以规范化后的完整路径为键，保存打开的fd、stat结果、Content-type以及只读映射。
+ * 条目以shared_ptr交给应答，写出方持有引用直到文件内容写完，条目被替换或淘汰后由最后一个引用者munmap、close，
+ * 因此热点文件的每个请求不再stat、open、mmap、close、munmap。不存在、是目录或打不开的路径同样缓存(负缓存)，
+ * 反复请求的404、403也不再访问文件系统。
+ * 条目距上次校验超过g_validate_ms时重新stat一次，inode、大小或修改时间变化(或存在与否变化)则重新打开。
+ * 按路径哈希分为若干分片，每个分片一把读写锁，命中只加读锁；分片满时淘汰最久未使用的条目
+ */
+class FileCache {
+public:
+    struct Entry {
+        Entry() = default;
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+        ~Entry();
+
+        std::string path; // 完整路径
+        bool found { false }; // 文件是否存在且不是目录，为false时是负缓存条目
+        int fd { -1 }; // 打开的文件，无权限打开时为-1
+        struct stat st {}; // 文件状态，打开成功时由fstat得到，与fd描述同一个文件
+        std::string mime; // 由后缀得到的Content-type
+        char* map { nullptr }; // 整个文件的只读映射，sendfile模式或空文件时为空
+        mutable std::atomic<int64_t> checked_ms { 0 }; // 上次校验的时间(ms)
+        mutable std::atomic<int64_t> used_ms { 0 }; // 上次被获取的时间(ms)，用于淘汰
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    static FileCache& GetInstance() // 懒汉单例模式
+    {
+        static FileCache m_instance;
+        return m_instance;
+    }
+
+    /**
+     * 获取path对应的文件，不存在或是目录时返回空。map为true时条目带有文件的映射；
+     * 无权限读取的文件也返回条目(fd为-1)，由调用者根据st判断403
+     */
+    EntryPtr Get(const std::string& path, bool map);
+    /**
+     * 按字面规范化请求路径：合并连续的'/'，去掉"."，".."回退一级且不超出根目录
+     */
+    static std::string Normalize(const std::string& path);
+
+    static size_t g_max_entries; // 最多缓存的文件数，每个条目占用一个fd，为0时不缓存
+    static int64_t g_validate_ms; // 条目的校验间隔(ms)，为0时每次获取都stat校验
+
+private:
+    static const size_t SHARD_NUM = 16;
+
+    struct Shard {
+        std::shared_mutex mtx;
+        std::unordered_map<std::string, EntryPtr> entries;
+    };
+
+    FileCache() = default;
+    /**
+     * 先打开文件再fstat，创建新条目；文件不存在或是目录时创建负缓存条目
+     */
+    static EntryPtr Load(const std::string& path, bool map, int64_t now);
+    /**
+     * 条目与新stat的结果是否仍是同一个文件的同一个版本
+     */
+    static bool SameFile(const struct stat& a, const struct stat& b);
+
+    Shard m_shards[SHARD_NUM];
+};
+
+#endif // _FILE_CACHE_H_
@@ -1,8 +1,14 @@
 #include "http_connector.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
 
 bool HttpConnector::g_is_ET;
 const char* HttpConnector::SRC_DIR;
 std::atomic<int> HttpConnector::g_user_count;
+std::unordered_map<std::string, HttpConnector::StreamRoute> HttpConnector::g_stream_routes;
 
 void HttpConnector::Init(int sockfd, const sockaddr_in& addr)
 {
@@ -13,11 +19,22 @@ void HttpConnector::Init(int sockfd, const sockaddr_in& addr)
     m_writeBuf.Clear();
     m_readBuf.Clear();
     m_is_close = false;
+    m_busy = false;
+    m_close_pending = false;
+    m_iov.clear();
+    m_iov_pos = 0;
+    m_to_write = 0;
+    m_keep_alive = false;
+    m_stream = nullptr;
+    m_request.Init();
 }
 
 void HttpConnector::Close()
 {
-    m_response.UnmapFile(); // 取消映射
+    m_response.ReleaseFile(); // 释放文件缓存条目的引用
+    ReleaseFiles();
+    m_stream = nullptr;
+    m_request.Init(); // 关闭请求体的临时文件
     if (!m_is_close) {
         m_is_close = true;
         g_user_count--; // 减少用户
@@ -34,6 +51,7 @@ ssize_t HttpConnector::Read(int* saveErrno)
             *saveErrno = errno;
             break;
         }
+        m_request.RequestLength(m_readBuf); // 每读一次就推进扫描，过长的请求体随读随写入临时文件，读缓冲不随上传的大小增长
     } while (g_is_ET); // 由于ET模式只通知一次，因此要将缓冲区内的这次数据全部读完
     return len;
 }
@@ -42,55 +60,171 @@ ssize_t HttpConnector::Write(int* saveErrno)
 {
     ssize_t len = -1;
     do {
-        /* m_iov[0]（写缓冲）存放状态行、头部字段和空行，m_iov[1]存放文档内容即应答体 */
-        len = writev(m_fd, m_iov, m_iov_cnt); // writev函数以顺序iov[0]、iov[1]至iov[iovcnt-1]从各缓冲区中聚集输出数据到fd，称为集中写
+        /* 各应答的状态行、头部字段和空行在写缓冲中，文档内容即应答体在映射的文件中，按顺序排在m_iov里一次集中写出 */
+        len = WriteOnce();
         if (len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if (m_iov[0].iov_len + m_iov[1].iov_len == 0) { // 写完成
-            break;
-        } else if (static_cast<size_t>(len) > m_iov[0].iov_len) { // 存在应答体
-            /* 下面是直接更新iov内存块的指针，以及写缓冲的指针，表示已经从写缓冲写入fd */
-            m_iov[1].iov_base = (uint8_t*)m_iov[1].iov_base + (len - m_iov[0].iov_len);
-            m_iov[1].iov_len -= (len - m_iov[0].iov_len);
-            if (m_iov[0].iov_len) {
-                m_writeBuf.Clear();
-                m_iov[0].iov_len = 0;
+        m_to_write -= len;
+        /* 跳过已经写完的iovec，并更新写了一部分的iovec的指针 */
+        size_t written = len;
+        while (written > 0) {
+            struct iovec& iov = m_iov[m_iov_pos];
+            if (written < iov.iov_len) {
+                if (iov.iov_base) { // 文件段的偏移已由sendfile推进
+                    iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + written;
+                }
+                iov.iov_len -= written;
+                break;
             }
-        } else { // 不存在应答体
-            m_iov[0].iov_base = (uint8_t*)m_iov[0].iov_base + len;
-            m_iov[0].iov_len -= len;
-            m_writeBuf.AddReadPos(len);
+            written -= iov.iov_len;
+            m_send_pos += iov.iov_base ? 0 : 1;
+            m_iov_pos++;
+        }
+        if (m_to_write == 0) { // 写完成，释放这一批应答
+            m_iov.clear();
+            m_iov_pos = 0;
+            m_writeBuf.AddReadPos(m_writeBuf.ReadableBytes());
+            ReleaseFiles();
+            if (!m_stream) {
+                break;
+            }
+            PullStream(); // 上一批已写出，流式应答继续产生下一批
+            if (m_writeBuf.ReadableBytes() == 0) { // 不分块的流式应答以空段结束，没有剩余数据
+                break;
+            }
+            m_iov.push_back({ m_writeBuf.GetReadPtr(), m_writeBuf.ReadableBytes() });
+            m_to_write = m_writeBuf.ReadableBytes();
         }
     } while (g_is_ET || ToWriteBytes() > 10240); // ET模式只通知一次，全部写入
     return len;
 }
 
+bool HttpConnector::MayBlock() const
+{
+    const char* begin = m_readBuf.GetReadPtr();
+    const char* end = m_readBuf.GetWritePtr();
+    for (size_t i = 0; i < PIPELINE_MAX; i++) { // 与Process处理同样多的请求，其中任何一个可能阻塞都交给线程池
+        size_t len = i == 0 ? m_request.BufferedLength() : HttpRequest::ScanLength(begin, end); // 第一个请求的请求体可能已移入临时文件
+        if (len == 0) {
+            break;
+        }
+        if (!((len >= 4 && memcmp(begin, "GET ", 4) == 0) || (len >= 5 && memcmp(begin, "HEAD ", 5) == 0))) {
+            return true;
+        }
+        begin += len;
+    }
+    return false;
+}
+
+bool HttpConnector::HasRequest()
+{
+    return m_request.RequestLength(m_readBuf) > 0;
+}
+
 bool HttpConnector::Process()
 {
-    m_request.Init(); // process之前，先重置用来保存请求报文属性的m_request
-    if (m_readBuf.ReadableBytes() <= 0) {
+    assert(m_to_write == 0);
+    /* 各应答头部在写缓冲中的结束位置与其文件，写缓冲可能扩容，全部生成后再填入iovec */
+    struct Pending {
+        size_t head_end;
+        char* file;
+        int file_fd;
+        size_t file_len;
+    } pending[PIPELINE_MAX];
+    size_t count = 0;
+    size_t len = 0;
+    m_writeBuf.AddReadPos(m_writeBuf.ReadableBytes());
+    while (count < PIPELINE_MAX && (len = m_request.RequestLength(m_readBuf)) > 0) {
+        bool ok = m_request.Parse(m_readBuf, len); // 先解析读缓冲的请求报文(Parse取走本请求后从下一个请求的开头扫描)，然后根据其内容重置用来写入应答报文的m_response
+        m_keep_alive = ok && m_request.IsKeepAlive();
+        m_response.Init(SRC_DIR, m_request.GetPath(), m_keep_alive, ok ? 200 : m_request.GetErrorCode());
+        auto route = ok && !g_stream_routes.empty() ? g_stream_routes.find(m_request.GetPath()) : g_stream_routes.end();
+        if (route != g_stream_routes.end()) { // 流式应答：先产生第一批应答体，与头部一起写出
+            m_stream_chunked = m_request.GetVersion() == "1.1";
+            m_keep_alive = m_keep_alive && m_stream_chunked;
+            m_stream = route->second(m_request);
+            m_response.MakeStreamResponse(m_writeBuf, m_stream_chunked);
+            PullStream();
+        } else {
+            m_response.MakeResponse(m_writeBuf);
+        }
+
+        Pending& item = pending[count++];
+        item.head_end = m_writeBuf.ReadableBytes();
+        item.file = nullptr;
+        item.file_fd = -1;
+        item.file_len = 0;
+        if (m_response.FileLen() > 0 && (m_response.GetFile() || m_response.GetFileFd() >= 0)) { // 文件内容在共享的映射中，或者由sendfile发送
+            item.file_len = m_response.FileLen();
+            item.file = m_response.GetFile();
+            item.file_fd = m_response.GetFileFd();
+            if (!item.file) {
+                m_send_files.push_back({ item.file_fd, 0 }); // 共享的fd，使用自己的偏移
+            }
+            m_files.push_back(m_response.ReleaseFile()); // 持有条目直到写完，期间条目即使被替换也不会munmap、close
+        }
+        if (!m_keep_alive || m_stream) { // 写完本应答后关闭连接，其后的请求不再处理；流式应答写完后再处理其后的请求
+            break;
+        }
+    }
+    if (count == 0) {
         return false;
     }
 
-    if (m_request.Parse(m_readBuf)) { // 先解析读缓冲的请求报文，然后根据其内容重置用来写入应答报文的m_response
-        m_response.Init(SRC_DIR, m_request.GetPath(), m_request.IsKeepAlive(), 200);
-    } else {
-        m_response.Init(SRC_DIR, m_request.GetPath(), false, 400);
+    char* head = m_writeBuf.GetReadPtr();
+    size_t head_begin = 0;
+    for (size_t i = 0; i < count; i++) {
+        m_iov.push_back({ head + head_begin, pending[i].head_end - head_begin }); // 状态行、头部字段和空行
+        head_begin = pending[i].head_end;
+        if (pending[i].file || pending[i].file_fd >= 0) { // sendfile的文件段以空的iov_base占位
+            m_iov.push_back({ pending[i].file, pending[i].file_len });
+        }
     }
+    m_to_write = 0;
+    for (auto& iov : m_iov) {
+        m_to_write += iov.iov_len;
+    }
+    return true;
+}
 
-    m_response.MakeResponse(m_writeBuf);
-    /* 状态行、头部字段和空行放在写缓冲 */
-    m_iov[0].iov_base = const_cast<char*>(m_writeBuf.GetReadPtr());
-    m_iov[0].iov_len = m_writeBuf.ReadableBytes();
-    m_iov_cnt = 1;
+void HttpConnector::PullStream()
+{
+    size_t begin = m_writeBuf.ReadableBytes();
+    while (m_stream && m_writeBuf.ReadableBytes() - begin < STREAM_HIGH_WATER) {
+        if (!HttpResponse::AppendChunk(m_writeBuf, m_stream, m_stream_chunked)) {
+            m_stream = nullptr; // 应答体已结束，结束分块随这一批写出
+        }
+    }
+}
 
-    /* 文件内容放在另一块内存 */
-    if (m_response.FileLen() > 0 && m_response.GetFile()) {
-        m_iov[1].iov_base = m_response.GetFile();
-        m_iov[1].iov_len = m_response.FileLen();
-        m_iov_cnt = 2;
+ssize_t HttpConnector::WriteOnce()
+{
+    if (m_iov_pos >= m_iov.size()) { // 没有待写出的数据
+        return 0;
     }
-    return true;
+    struct iovec& first = m_iov[m_iov_pos];
+    if (!first.iov_base) {
+        SendFile& file = m_send_files[m_send_pos];
+        return sendfile(m_fd, file.fd, &file.offset, first.iov_len);
+    }
+    size_t end = m_iov_pos;
+    while (end < m_iov.size() && end - m_iov_pos < IOV_MAX && m_iov[end].iov_base) {
+        end++;
+    }
+    if (end == m_iov.size() || m_iov[end].iov_base) { // 其后没有文件段
+        return writev(m_fd, &first, static_cast<int>(end - m_iov_pos));
+    }
+    struct msghdr msg = {};
+    msg.msg_iov = &first;
+    msg.msg_iovlen = end - m_iov_pos;
+    return sendmsg(m_fd, &msg, MSG_MORE);
+}
+
+void HttpConnector::ReleaseFiles()
+{
+    m_files.clear();
+    m_send_files.clear();
+    m_send_pos = 0;
 }
\ No newline at end of file
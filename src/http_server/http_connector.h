@@ -2,6 +2,7 @@
 #define _HTTP_CONNECTOR_H
 
 #include <arpa/inet.h>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <cstddef>
@@ -9,6 +10,8 @@
 #include <string>
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <unordered_map>
+#include <vector>
 
 #include "../buffer/buffer.h"
 #include "http_request.h"
@@ -24,6 +27,29 @@
  */
 class HttpConnector {
 public:
+    static const size_t PIPELINE_MAX = 64; // 一次Process最多处理的流水线请求数，其余的等这一批写完再处理
+    static const size_t STREAM_HIGH_WATER = 64 * 1024; // 流式应答一次最多产生的字节数，写出后再产生下一批
+
+    /**
+     * 动态路由：根据请求创建流式应答体的产生者
+     */
+    using StreamRoute = std::function<HttpResponse::BodyProducer(const HttpRequest& request)>;
+    /**
+     * 注册路径对应的流式应答，请求该路径时不再读取文件，应答体由产生者逐段生成并以分块编码边生成边写出；
+     * 应在服务启动之前注册
+     */
+    static void AddStreamRoute(const std::string& path, StreamRoute route) { g_stream_routes[path] = std::move(route); }
+    /**
+     * 注册接收请求体的路径：请求体完整接收后调用route，由它通过GetBody或GetBodyFd(超过g_body_memory_limit时)读取请求体并创建应答，
+     * 其他路径上超过g_body_memory_limit的请求体直接应答413。route在Process中调用，POST请求由线程池处理，可以在其中阻塞地读取；
+     * 产生者可能在Reactor线程中调用，不应再读取请求体。应在服务启动之前注册
+     */
+    static void AddBodyRoute(const std::string& path, StreamRoute route)
+    {
+        HttpRequest::AddBodyConsumer(path);
+        AddStreamRoute(path, std::move(route));
+    }
+
     /**
      * 构造方法，应传递connfd，以及客户端addr作为参数
      */
@@ -51,30 +77,83 @@ public:
     sockaddr_in GetAddr() const { return m_addr; }
 
     /**
-     * 处理事务的入口函数
+     * 处理事务的入口函数：依次处理读缓冲中所有完整的请求(HTTP/1.1 pipelining)，应答按请求顺序排队，由Write一并写出，
+     * 读缓冲中没有完整的请求时返回false
      */
     bool Process();
+    /**
+     * 读缓冲中是否已有一个完整的请求，请求头分多次到达时从上次扫描到的位置继续
+     */
+    bool HasRequest();
 
     /**
-     * 返回需要写出的字节数
+     * 返回需要写出的字节数，流式应答尚未产生完时至少为1
      */
-    int ToWriteBytes() { return m_iov[0].iov_len + m_iov[1].iov_len; }
+    size_t ToWriteBytes() const { return m_to_write > 0 ? m_to_write : m_stream ? 1 : 0; }
+    /**
+     * 返回读缓冲中尚未处理的字节数
+     */
+    size_t ToReadBytes() const { return m_readBuf.ReadableBytes(); }
 
-    bool IsKeepAlive() const { return m_request.IsKeepAlive(); }
+    /**
+     * 最后一个应答是否保持连接
+     */
+    bool IsKeepAlive() const { return m_keep_alive; }
+
+    /**
+     * 根据读缓冲中各请求行的方法粗略判断处理是否可能阻塞：GET/HEAD只读取静态文件，其余方法（登录、注册的POST）可能访问数据库
+     */
+    bool MayBlock() const;
+
+    /* 标记连接正在线程池中处理，期间由工作线程独占，所属线程不关闭、不复用该连接 */
+    void SetBusy(bool busy) { m_busy.store(busy, std::memory_order_release); }
+    bool IsBusy() const { return m_busy.load(std::memory_order_acquire); }
+    /* 处理期间对端挂断或超时，标记由所属线程在处理完成后关闭，只在所属线程中访问 */
+    void SetClosePending() { m_close_pending = true; }
+    bool IsClosePending() const { return m_close_pending; }
 
     static bool g_is_ET; // ET模式
     static const char* SRC_DIR; // 请求文件对应的根目录
     static std::atomic<int> g_user_count; // 所有connector共享的用户计数器
 
 private:
+    /**
+     * 释放已写出的应答所引用的文件缓存条目
+     */
+    void ReleaseFiles();
+    /**
+     * 从m_iov_pos起写出一次：连续的内存段合并为一次writev，其后还有文件段时用sendmsg加MSG_MORE，
+     * 让头部与随后sendfile的文件内容合并成满的TCP段；文件段用sendfile从页缓存直接发送
+     */
+    ssize_t WriteOnce();
+    /**
+     * 从流式应答的产生者取数据追加到写缓冲，直到超过STREAM_HIGH_WATER或应答体结束
+     */
+    void PullStream();
+
+    static std::unordered_map<std::string, StreamRoute> g_stream_routes; // 路径对应的流式应答
+
     int m_fd; // 管理的socketfd
     struct sockaddr_in m_addr; // 管理的socketaddr
 
     bool m_is_close; // 是否连接已关闭
-
-    /* 下面二者是用来是实现分散写的结构 */
-    int m_iov_cnt {};
-    struct iovec m_iov[2] {};
+    std::atomic<bool> m_busy { false }; // 是否正在线程池中处理
+    bool m_close_pending {}; // 处理完成后是否关闭
+
+    /* 下面是用来实现集中写的结构：每个应答的状态行和头部在写缓冲中，文件内容在映射的内存中，按顺序排成iovec */
+    std::vector<struct iovec> m_iov;
+    size_t m_iov_pos {}; // 第一个尚未写完的iovec
+    size_t m_to_write {}; // 尚未写出的字节数
+    std::vector<FileCache::EntryPtr> m_files; // 等待写出的应答所引用的文件缓存条目
+    struct SendFile {
+        int fd; // 文件缓存条目的fd，由m_files中的引用保持打开
+        off_t offset; // 下一个要发送的字节，由sendfile推进
+    };
+    std::vector<SendFile> m_send_files; // sendfile模式下等待写出的文件，依次对应m_iov中iov_base为空的项
+    size_t m_send_pos {}; // 第一个尚未写完的文件
+    bool m_keep_alive {}; // 最后一个应答是否保持连接
+    HttpResponse::BodyProducer m_stream; // 尚未产生完的流式应答，总是一批应答中的最后一个
+    bool m_stream_chunked {}; // 流式应答是否使用分块编码
 
     Buffer m_readBuf; // 读缓冲区
     Buffer m_writeBuf; // 写缓冲区
@@ -0,0 +1,176 @@
+#include "http_parser.h"
+#include "http_scan.h"
+#include <cstring>
+#include <strings.h>
+
+/* 常用请求头的名字，与HttpParser::KnownHeader的顺序一致 */
+static constexpr std::string_view KNOWN_NAMES[HttpParser::HEADER_COUNT] = {
+    "Connection", "Content-Length", "Content-Type", "Host", "Accept-Encoding", "If-None-Match", "Range", "Cookie",
+};
+static constexpr size_t MAX_KNOWN_LEN = 15; // 常用请求头名字的最大长度
+
+/**
+ * 常用请求头名字的长度各不相同，以长度作完美哈希：编译期生成长度到请求头的表，并检查没有冲突
+ */
+struct KnownTable {
+    HttpParser::KnownHeader slot[MAX_KNOWN_LEN + 1];
+
+    constexpr KnownTable()
+        : slot {}
+    {
+        for (size_t len = 0; len <= MAX_KNOWN_LEN; len++) {
+            slot[len] = HttpParser::HEADER_COUNT;
+        }
+        for (size_t i = 0; i < HttpParser::HEADER_COUNT; i++) {
+            slot[KNOWN_NAMES[i].size()] = static_cast<HttpParser::KnownHeader>(i);
+        }
+    }
+    constexpr bool Valid() const
+    {
+        for (size_t i = 0; i < HttpParser::HEADER_COUNT; i++) {
+            if (KNOWN_NAMES[i].size() > MAX_KNOWN_LEN || slot[KNOWN_NAMES[i].size()] != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static constexpr KnownTable KNOWN_TABLE;
+static_assert(KNOWN_TABLE.Valid(), "known header names must have distinct lengths");
+
+static bool IsBlank(char ch)
+{
+    return ch == ' ' || ch == '\t';
+}
+
+bool HttpParser::Parse(const char* begin, const char* end)
+{
+    Reset();
+    uint32_t index[MAX_INDEX]; // 结构字符相对base的偏移
+    size_t count = 0;
+    size_t i = 0;
+    const char* base = nullptr;
+    const char* lineBegin = begin;
+    const char* colon = nullptr; // 当前行中第一个':'
+    while (true) {
+        if (i == count) { // 索引已用完，从当前行的行首起继续扫描
+            if (base && count < MAX_INDEX) { // 上次已扫描到结尾，请求头没有以空行结束
+                return false;
+            }
+            if (base == lineBegin) { // 一行中的':'超过了MAX_INDEX个
+                return false;
+            }
+            base = lineBegin;
+            count = HttpScan::IndexStructural(base, end, index, MAX_INDEX);
+            i = 0;
+            colon = nullptr;
+            continue;
+        }
+        const char* pos = base + index[i++];
+        if (*pos == ':') {
+            colon = colon ? colon : pos;
+            continue;
+        }
+        if (pos == lineBegin || pos[-1] != '\r') { // 每行都应以\r\n结束
+            return false;
+        }
+        bool ok = lineBegin == begin ? ParseRequestLine(lineBegin, pos - 1) : ParseHeader(lineBegin, colon, pos - 1);
+        if (!ok) {
+            return false;
+        }
+        if (end - pos > 2 && pos[1] == '\r' && pos[2] == '\n') { // 其后是空行，请求头结束
+            m_body = std::string_view(pos + 3, end - pos - 3);
+            return true;
+        }
+        lineBegin = pos + 1;
+        colon = nullptr;
+    }
+}
+
+void HttpParser::Reset()
+{
+    m_method = m_path = m_version = m_body = std::string_view();
+    for (std::string_view& value : m_known) {
+        value = std::string_view();
+    }
+    m_known_count = 0;
+    m_headers.clear(); // 保留容量，下一个请求不再申请内存
+}
+
+HttpParser::KnownHeader HttpParser::Lookup(std::string_view name)
+{
+    if (name.size() > MAX_KNOWN_LEN) {
+        return HEADER_COUNT;
+    }
+    KnownHeader header = KNOWN_TABLE.slot[name.size()];
+    if (header == HEADER_COUNT || strncasecmp(KNOWN_NAMES[header].data(), name.data(), name.size()) != 0) {
+        return HEADER_COUNT;
+    }
+    return header;
+}
+
+std::string_view HttpParser::GetHeader(std::string_view name) const
+{
+    KnownHeader known = Lookup(name);
+    if (known != HEADER_COUNT) {
+        return m_known[known];
+    }
+    for (const Header& header : m_headers) {
+        if (header.name.size() == name.size() && strncasecmp(header.name.data(), name.data(), name.size()) == 0) {
+            return header.value;
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpParser::ParseRequestLine(const char* begin, const char* end)
+{
+    const char* methodEnd = HttpScan::FindByte(begin, end, ' ');
+    if (methodEnd == end || methodEnd == begin) {
+        return false;
+    }
+    const char* path = methodEnd + 1;
+    const char* pathEnd = HttpScan::FindByte(path, end, ' ');
+    if (pathEnd == end || pathEnd == path) {
+        return false;
+    }
+    const char* version = pathEnd + 1;
+    if (end - version <= 5 || memcmp(version, "HTTP/", 5) != 0) {
+        return false;
+    }
+    version += 5;
+    if (HttpScan::FindByte(version, end, ' ') != end) {
+        return false;
+    }
+    m_method = std::string_view(begin, methodEnd - begin);
+    m_path = std::string_view(path, pathEnd - path);
+    m_version = std::string_view(version, end - version);
+    return true;
+}
+
+bool HttpParser::ParseHeader(const char* begin, const char* colon, const char* end)
+{
+    if (!colon || colon == begin) {
+        return false;
+    }
+    const char* value = colon + 1;
+    while (value < end && IsBlank(*value)) {
+        value++;
+    }
+    const char* valueEnd = end;
+    while (valueEnd > value && IsBlank(valueEnd[-1])) {
+        valueEnd--;
+    }
+    std::string_view name(begin, colon - begin);
+    KnownHeader known = Lookup(name);
+    if (known == HEADER_COUNT) {
+        m_headers.push_back({ name, std::string_view(value, valueEnd - value) });
+        return true;
+    }
+    if (m_known[known].data() == nullptr) { // 重复时保留第一个
+        m_known[known] = std::string_view(value, valueEnd - value);
+    }
+    m_known_count++;
+    return true;
+}
@@ -0,0 +1,92 @@
+#ifndef _HTTP_PARSER_H_
+#define _HTTP_PARSER_H_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+/**
+ * 手写状态机的http请求解析器，不使用正则表达式，也不复制报文：请求行的方法、路径、版本，各请求头的名字与值，以及请求体，
+ * 都以string_view记录在原缓冲区中的位置，在缓冲区被改写(下一次读取)之前有效。
+ * 常用请求头由名字长度构成的完美哈希识别后存入固定位置，其余的存放在复用的数组中，同一个解析器反复使用时，通常的请求不会申请堆内存。不依赖数据库与日志，可单独测试。
+ * 请求头先由HttpScan的SIMD内核一次扫描出全部'\n'与':'的位置，再按这些位置切分各行，不再逐行逐字节查找。
+ */
+class HttpParser {
+public:
+    struct Header {
+        std::string_view name;
+        std::string_view value; // 已去掉首尾空白
+    };
+
+    /* 常用的请求头，解析时识别出来直接存入固定的位置，查找时不需要比较名字 */
+    enum KnownHeader {
+        HEADER_CONNECTION,
+        HEADER_CONTENT_LENGTH,
+        HEADER_CONTENT_TYPE,
+        HEADER_HOST,
+        HEADER_ACCEPT_ENCODING,
+        HEADER_IF_NONE_MATCH,
+        HEADER_RANGE,
+        HEADER_COOKIE,
+        HEADER_COUNT,
+    };
+
+    HttpParser() { m_headers.reserve(16); }
+    ~HttpParser() = default;
+
+    /**
+     * 解析[begin, end)中的一个完整请求：请求行、以空行结束的请求头，其后到end为止的内容都作为请求体。
+     * 报文格式错误时返回false
+     */
+    bool Parse(const char* begin, const char* end);
+    /**
+     * 清空上一个请求的解析结果
+     */
+    void Reset();
+
+    std::string_view GetMethod() const { return m_method; }
+    std::string_view GetPath() const { return m_path; }
+    std::string_view GetVersion() const { return m_version; }
+    std::string_view GetBody() const { return m_body; }
+    /**
+     * 返回常用请求头的值，不存在时返回空串；同名请求头出现多次时返回第一个
+     */
+    std::string_view GetHeader(KnownHeader header) const { return m_known[header]; }
+    /**
+     * 按名字查找请求头(不区分大小写)，不存在时返回空串；常用请求头直接取固定位置，其余的在数组中逐个比较
+     */
+    std::string_view GetHeader(std::string_view name) const;
+    /**
+     * 常用请求头以外的请求头，按出现的顺序
+     */
+    const std::vector<Header>& GetOtherHeaders() const { return m_headers; }
+    /**
+     * 请求头的总数
+     */
+    size_t HeaderCount() const { return m_known_count + m_headers.size(); }
+
+    /**
+     * 识别常用请求头的名字(不区分大小写)，不是常用请求头时返回HEADER_COUNT
+     */
+    static KnownHeader Lookup(std::string_view name);
+
+private:
+    /**
+     * 解析不含\r\n的请求行：方法 空格 路径 空格 HTTP/版本
+     */
+    bool ParseRequestLine(const char* begin, const char* end);
+    /**
+     * 解析不含\r\n的一行请求头：名字:值，colon为行中第一个':'的位置，没有时为nullptr
+     */
+    bool ParseHeader(const char* begin, const char* colon, const char* end);
+
+    static const size_t MAX_INDEX = 256; // 一次扫描最多记录的结构字符数，更多时分段扫描
+
+    std::string_view m_method, m_path, m_version;
+    std::string_view m_known[HEADER_COUNT]; // 常用请求头的值
+    size_t m_known_count {}; // 出现的常用请求头个数，含重复的
+    std::vector<Header> m_headers; // 其余的请求头
+    std::string_view m_body;
+};
+
+#endif // _HTTP_PARSER_H_
@@ -1,4 +1,17 @@
 #include "http_request.h"
+#include "http_scan.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+size_t HttpRequest::g_body_memory_limit = 1 << 20;
+size_t HttpRequest::g_body_max_size = 64 << 20;
+size_t HttpRequest::g_chunk_max_size = 16 << 20;
+std::string HttpRequest::g_spill_dir = "/tmp";
 
 const std::unordered_set<std::string> HttpRequest::DEFAULT_HTML {
     "/index",
@@ -14,6 +27,8 @@ const std::unordered_map<std::string, int> HttpRequest::DEFAULT_HTML_TAG {
     { "/login.html", 1 },
 };
 
+std::unordered_set<std::string> HttpRequest::g_body_consumers;
+
 static int ConvertHex(char ch)
 {
     if (ch >= 'A' && ch <= 'F')
@@ -25,9 +40,18 @@ static int ConvertHex(char ch)
 
 void HttpRequest::Init()
 {
-    m_method = m_body = m_path = m_version = "";
-    m_state = CHECK_STATE_REQUESTLINE;
-    m_header.clear();
+    ResetFrame();
+    m_error = 400;
+    m_body_size = 0;
+    for (int* fd : { &m_spill_fd, &m_body_fd }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    m_parser.Reset();
+    m_path.clear();
+    m_body.clear();
     m_post.clear();
 }
 
@@ -42,103 +66,392 @@ std::string HttpRequest::GetPost(const std::string& key)
 
 bool HttpRequest::IsKeepAlive() const
 {
-    if (m_header.count("Connection") == 1) {
-        return m_header.at("Connection") == "keep-alive" && m_version == "1.1";
+    return m_parser.GetHeader(HttpParser::HEADER_CONNECTION) == "keep-alive" && m_parser.GetVersion() == "1.1";
+}
+
+bool HttpRequest::Parse(Buffer& buff, size_t len)
+{
+    assert(len <= buff.ReadableBytes());
+    const char* begin = buff.GetReadPtr();
+    buff.AddReadPos(len); // 取走整个请求，解析结果仍指向读缓冲中的原位置
+    /* 接收状态移交给本请求，下一个请求从头扫描 */
+    if (m_body_fd >= 0) {
+        close(m_body_fd);
     }
-    return false;
+    m_body_fd = m_spill_fd;
+    m_spill_fd = -1;
+    int frameError = m_frame_error;
+    m_body_size = frameError ? 0 : m_body_len;
+    ResetFrame();
+    m_path.clear();
+    m_body.clear();
+    m_post.clear();
+    m_error = frameError ? frameError : 400;
+    if (!m_parser.Parse(begin, begin + len) || frameError) {
+        return false;
+    }
+
+    m_path.assign(m_parser.GetPath().data(), m_parser.GetPath().size());
+    CompletePath(m_path);
+
+    if (m_parser.GetBody().empty() && m_body_fd < 0) {
+        return true;
+    }
+    return ParseBody();
+}
+
+size_t HttpRequest::RequestLength(Buffer& buff)
+{
+    const char* begin = buff.GetReadPtr();
+    size_t readable = buff.ReadableBytes();
+    if (m_head_len == 0) {
+        /* \r\n\r\n可能跨越上次扫描的结尾，从结尾前3个字节起继续扫描 */
+        const char* from = begin + (m_scanned > 3 ? m_scanned - 3 : 0);
+        const char* headEnd = HttpScan::FindHeadEnd(from, begin + readable);
+        if (headEnd == begin + readable) {
+            m_scanned = readable;
+            return readable > MAX_HEAD_SIZE ? readable : 0;
+        }
+        headEnd += 4;
+        m_head_len = headEnd - begin;
+        m_body_len = BodyLength(begin, headEnd, &m_chunked);
+        if (m_body_len == SIZE_MAX) { // Content-Length或Transfer-Encoding不合法，无法确定请求的边界
+            m_body_len = 0;
+            m_chunked = false;
+            m_frame_error = 400;
+        } else if (m_body_len > g_body_max_size) { // 不再接收请求体，应答后关闭连接
+            LOG_WARN("Request body too large: %zu", m_body_len);
+            m_body_len = 0;
+            m_frame_error = 413;
+        } else if (m_body_len > g_body_memory_limit && !HasBodyConsumer(begin, headEnd)) { // 没有处理者会读取，不接收请求体
+            LOG_WARN("Request body too large without consumer: %zu", m_body_len);
+            m_body_len = 0;
+            m_frame_error = 413;
+        } else if (m_body_len > g_body_memory_limit) {
+            m_spill_fd = OpenSpillFile();
+            if (m_spill_fd < 0) {
+                m_body_len = 0;
+                m_frame_error = 413;
+            }
+        }
+    }
+    if (m_frame_error) { // 只取走请求头，应答错误后关闭连接
+        return m_head_len + m_body_len - m_spilled;
+    }
+    if (m_chunked) {
+        if (!DecodeChunked(buff)) {
+            return m_head_len + m_body_len - m_spilled;
+        }
+        if (m_spill_fd < 0 && m_body_len > g_body_memory_limit) { // 解码出的请求体超过上限，此后随解码写入临时文件
+            if (!HasBodyConsumer(buff.GetReadPtr(), buff.GetReadPtr() + m_head_len)) {
+                LOG_WARN("Chunked request body too large without consumer: %zu", m_body_len);
+                m_frame_error = 413;
+                return m_head_len + m_body_len;
+            }
+            m_spill_fd = OpenSpillFile();
+            if (m_spill_fd < 0) {
+                m_frame_error = 413;
+                return m_head_len + m_body_len;
+            }
+        }
+    }
+    if (m_spill_fd >= 0) {
+        if (!Spill(buff)) {
+            m_body_len = m_spilled = 0;
+            m_frame_error = 413;
+            return m_head_len;
+        }
+    } else if (!m_chunked && readable - m_head_len < m_body_len) { // 请求体还没有收全
+        return 0;
+    }
+    return BufferedLength();
+}
+
+size_t HttpRequest::BufferedLength() const
+{
+    if (m_head_len == 0) {
+        return 0;
+    }
+    if (m_frame_error) {
+        return m_head_len + m_body_len - m_spilled;
+    }
+    if (m_chunked) {
+        return m_chunk_state == CHUNK_DONE ? m_head_len + m_body_len - m_spilled : 0;
+    }
+    if (m_spill_fd >= 0) {
+        return m_spilled == m_body_len ? m_head_len : 0;
+    }
+    return m_head_len + m_body_len;
+}
+
+size_t HttpRequest::ScanLength(const char* begin, const char* end)
+{
+    const char* headEnd = HttpScan::FindHeadEnd(begin, end);
+    if (headEnd == end) {
+        return static_cast<size_t>(end - begin) > MAX_HEAD_SIZE ? end - begin : 0;
+    }
+    headEnd += 4;
+    bool chunked = false;
+    size_t bodyLen = BodyLength(begin, headEnd, &chunked);
+    if (bodyLen == SIZE_MAX) { // 错误的请求，只取走请求头
+        return headEnd - begin;
+    }
+    if (chunked || static_cast<size_t>(end - headEnd) < bodyLen) {
+        return 0;
+    }
+    return headEnd - begin + bodyLen;
 }
 
-bool HttpRequest::Parse(Buffer& buff)
+void HttpRequest::CompletePath(std::string& path)
 {
-    const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0) {
+    /* 若path存在，补全其路径(加上.html) */
+    if (path == "/") { // 根目录
+        path = "/index.html";
+    } else if (DEFAULT_HTML.count(path) == 1) {
+        path += ".html";
+    }
+}
+
+bool HttpRequest::HasBodyConsumer(const char* begin, const char* headEnd)
+{
+    if (g_body_consumers.empty()) {
+        return false;
+    }
+    const char* path = HttpScan::FindByte(begin, headEnd, ' ');
+    if (path == headEnd) {
         return false;
     }
-    while (buff.ReadableBytes() && m_state != CHECK_STATE_FINISH) { // 状态机，一行一行循环解析
-        char* lineEnd = std::search(buff.GetReadPtr(), buff.GetWritePtr(), CRLF, CRLF + 2); // 在可读数据中找到分隔符\r\n
-        const std::string line(buff.GetReadPtr(), lineEnd); // 根据分割符提取出一个完整的行
-        switch (m_state) { // 根据状态机状态跳转
-        case CHECK_STATE_REQUESTLINE:
-            if (!ParseRequestLine(line)) { // 解析请求行，解析请求行失败代表请求格式错误
-                return false;
+    path++;
+    std::string target(path, HttpScan::FindByte(path, headEnd, ' ') - path); // 与Parse得到的路径相同，按补全后的路径查找
+    CompletePath(target);
+    return g_body_consumers.count(target) == 1;
+}
+
+/**
+ * 返回line中KEY(含':')之后去掉首尾空白的值，不是该请求头时返回nullptr
+ */
+static const char* HeaderValue(const char* line, const char* lineEnd, const char* key, size_t keyLen, const char** valueEnd)
+{
+    if (static_cast<size_t>(lineEnd - line) <= keyLen || strncasecmp(line, key, keyLen) != 0) {
+        return nullptr;
+    }
+    const char* value = line + keyLen;
+    while (value < lineEnd && (*value == ' ' || *value == '\t')) {
+        value++;
+    }
+    *valueEnd = lineEnd;
+    while (*valueEnd > value && ((*valueEnd)[-1] == ' ' || (*valueEnd)[-1] == '\t')) {
+        (*valueEnd)--;
+    }
+    return value;
+}
+
+size_t HttpRequest::BodyLength(const char* begin, const char* headEnd, bool* chunked)
+{
+    const char CL_KEY[] = "content-length:";
+    const char TE_KEY[] = "transfer-encoding:";
+    bool hasLength = false;
+    size_t len = 0;
+    *chunked = false;
+    for (const char* line = begin; line < headEnd;) {
+        const char* lineEnd = HttpScan::FindCRLF(line, headEnd);
+        const char* valueEnd = nullptr;
+        if (const char* value = HeaderValue(line, lineEnd, CL_KEY, sizeof(CL_KEY) - 1, &valueEnd)) {
+            /* 只接受十进制数字，负数、空值、溢出与重复都不合法 */
+            if (hasLength || value == valueEnd) {
+                return SIZE_MAX;
+            }
+            hasLength = true;
+            for (; value < valueEnd; value++) {
+                if (*value < '0' || *value > '9' || len > (SIZE_MAX - 9) / 10) {
+                    return SIZE_MAX;
+                }
+                len = len * 10 + (*value - '0');
+            }
+        } else if (const char* value = HeaderValue(line, lineEnd, TE_KEY, sizeof(TE_KEY) - 1, &valueEnd)) {
+            /* 只支持单独的chunked，其他编码无法确定请求体的边界 */
+            const char CHUNKED[] = "chunked";
+            if (*chunked || valueEnd - value != sizeof(CHUNKED) - 1 || strncasecmp(value, CHUNKED, sizeof(CHUNKED) - 1) != 0) {
+                return SIZE_MAX;
+            }
+            *chunked = true;
+        }
+        line = lineEnd + 2;
+    }
+    if (*chunked && hasLength) { // 两者同时出现时代理与服务器可能对请求边界理解不一(请求走私)，拒绝
+        return SIZE_MAX;
+    }
+    return len;
+}
+
+void HttpRequest::ResetFrame()
+{
+    m_scanned = m_head_len = m_body_len = m_spilled = 0;
+    m_chunked = false;
+    m_chunk_state = CHUNK_SIZE;
+    m_chunk_left = m_chunk_line = 0;
+    m_frame_error = 0;
+}
+
+static int HexValue(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+        return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+        return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+        return ch - 'A' + 10;
+    return -1;
+}
+
+bool HttpRequest::DecodeChunked(Buffer& buff)
+{
+    char* base = buff.GetReadPtr();
+    const size_t end = buff.ReadableBytes();
+    const size_t decoded = m_head_len + m_body_len - m_spilled; // 读缓冲中已解码的请求体的结尾，其后都是未解码的字节
+    size_t out = decoded;
+    size_t in = decoded;
+    int error = 0;
+    while (in < end && m_chunk_state != CHUNK_DONE && !error) {
+        if (m_chunk_state == CHUNK_DATA) { // 数据前移，接在已解码的请求体之后
+            size_t len = std::min(m_chunk_left, end - in);
+            if (out != in) {
+                memmove(base + out, base + in, len);
+            }
+            out += len;
+            in += len;
+            m_body_len += len;
+            m_chunk_left -= len;
+            if (m_chunk_left == 0) {
+                m_chunk_state = CHUNK_DATA_CR;
             }
-            m_state = CHECK_STATE_HEADER; // 解析成功，转移状态
+            continue;
+        }
+        char ch = base[in++];
+        if (++m_chunk_line > MAX_HEAD_SIZE) { // 分块大小行或trailer过长
+            error = 400;
             break;
-        case CHECK_STATE_HEADER:
-            if (!ParseHeader(line)) { // 解析一行请求头，返回false代表本行不是请求头，即请求头全部解析完成
-                if (buff.ReadableBytes() <= 2) { // 若只剩下\r\n，说明没有请求体
-                    m_state = CHECK_STATE_FINISH; // 解析结束
+        }
+        switch (m_chunk_state) {
+        case CHUNK_SIZE: {
+            int digit = HexValue(ch);
+            if (digit >= 0) {
+                if (m_chunk_left > (g_chunk_max_size >> 4)) {
+                    error = 413;
                 } else {
-                    m_state = CHECK_STATE_BODY; // 转移状态至解析请求体
+                    m_chunk_left = m_chunk_left * 16 + digit;
                 }
+            } else if (m_chunk_line == 1) { // 至少一位十六进制数字
+                error = 400;
+            } else if (ch == ';' || ch == ' ' || ch == '\t') {
+                m_chunk_state = CHUNK_EXT;
+            } else if (ch == '\r') {
+                m_chunk_state = CHUNK_SIZE_LF;
+            } else {
+                error = 400;
             }
             break;
-        case CHECK_STATE_BODY:
-            m_body = line;
-            if (!ParseBody(line)) { // 解析请求体，解析请求体失败代表请求体格式错误
-                return false;
+        }
+        case CHUNK_EXT:
+            if (ch == '\r') {
+                m_chunk_state = CHUNK_SIZE_LF;
             }
-            m_state = CHECK_STATE_FINISH; // 解析成功，转移状态
             break;
-        default:
+        case CHUNK_SIZE_LF:
+            if (ch != '\n') {
+                error = 400;
+            } else if (m_chunk_left > g_chunk_max_size || m_body_len + m_chunk_left > g_body_max_size) {
+                error = 413;
+            } else {
+                m_chunk_state = m_chunk_left == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+                m_chunk_line = 0; // trailer的长度从此累计
+            }
             break;
-        }
-        if (lineEnd == buff.GetWritePtr()) { // 没找到分隔符
-            if (m_method == "POST" && m_state == CHECK_STATE_FINISH) { // POST请求体最后直接结束，没有分隔符
-                buff.SetReadPos(lineEnd); // 设置已读指针到报文结尾
+        case CHUNK_DATA_CR:
+            m_chunk_state = CHUNK_DATA_LF;
+            error = ch == '\r' ? 0 : 400;
+            break;
+        case CHUNK_DATA_LF:
+            m_chunk_state = CHUNK_SIZE;
+            m_chunk_line = 0;
+            error = ch == '\n' ? 0 : 400;
+            break;
+        case CHUNK_TRAILER:
+            m_chunk_state = ch == '\r' ? CHUNK_END_LF : CHUNK_TRAILER_LINE;
+            break;
+        case CHUNK_TRAILER_LINE:
+            if (ch == '\n') {
+                m_chunk_state = CHUNK_TRAILER;
             }
             break;
+        case CHUNK_END_LF:
+            m_chunk_state = CHUNK_DONE;
+            error = ch == '\n' ? 0 : 400;
+            break;
+        default:
+            break;
         }
-        buff.SetReadPos(lineEnd + 2); // 设置已读指针，跳过分隔符\r\n，进入下个while继续解析下一行
+    }
+    buff.Erase(out, in - out); // 删除已解码部分的分块框架，未解码的字节与流水线上其后的请求紧接在请求体之后
+    if (error) {
+        LOG_WARN("Bad chunked request body, code: %d", error);
+        m_frame_error = error;
+        return false;
     }
     return true;
 }
 
-bool HttpRequest::ParseRequestLine(const std::string& line)
+int HttpRequest::OpenSpillFile()
 {
-    /* 下面利用正则表达式解析请求行 */
-    std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    std::smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        m_method = subMatch[1];
-        m_path = subMatch[2];
-        m_version = subMatch[3];
-
-        /* 若path存在，补全其路径(加上.html) */
-        if (m_path == "/") { // 根目录
-            m_path = "/index.html";
-        } else {
-            for (auto& item : DEFAULT_HTML) {
-                if (item == m_path) {
-                    m_path += ".html";
-                    break;
-                }
-            }
+    int fd = open(g_spill_dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR); // 不出现在目录中，关闭后自动删除
+    if (fd < 0) { // 文件系统不支持O_TMPFILE
+        std::string path = g_spill_dir + "/webserver_body_XXXXXX";
+        fd = mkostemp(&path[0], O_CLOEXEC);
+        if (fd >= 0) {
+            unlink(path.c_str());
         }
-
-        return true;
     }
-    return false;
+    if (fd < 0) {
+        LOG_ERROR("Open spill file in %s failed, errno: %d", g_spill_dir.c_str(), errno);
+    }
+    return fd;
 }
 
-bool HttpRequest::ParseHeader(const std::string& line)
+bool HttpRequest::Spill(Buffer& buff)
 {
-    /* 下面利用正则表达式解析请求头 */
-    std::regex patten("^([^:]*): ?(.*)$");
-    std::smatch subMatch;
-    if (regex_match(line, subMatch, patten)) {
-        m_header[subMatch[1]] = subMatch[2]; // 保存请求头的属性
-        return true;
+    size_t len = std::min(buff.ReadableBytes() - m_head_len, m_body_len - m_spilled);
+    const char* data = buff.GetReadPtr() + m_head_len;
+    for (size_t written = 0; written < len;) {
+        ssize_t ret = write(m_spill_fd, data + written, len - written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            LOG_ERROR("Write spill file failed, errno: %d", errno);
+            close(m_spill_fd);
+            m_spill_fd = -1;
+            return false;
+        }
+        written += ret;
     }
-    return false;
+    buff.Erase(m_head_len, len); // 读缓冲中只留请求头与其后流水线上的请求
+    m_spilled += len;
+    return true;
 }
 
-bool HttpRequest::ParseBody(const std::string& line)
+bool HttpRequest::ParseBody()
 {
-    if (m_method == "GET") // GET方法不支持body传参，直接忽略
+    if (m_parser.GetMethod() == "GET") // GET方法不支持body传参，直接忽略
         return true;
 
-    if (m_method == "POST" && m_header["Content-Type"] == "application/x-www-form-urlencoded") {
+    if (g_body_consumers.count(m_path) == 1) { // 请求体由该路径的处理者读取
+        return true;
+    }
+    if (m_body_fd >= 0) { // 只有登记了处理者的路径才会把请求体写入临时文件
+        return false;
+    }
+    if (m_parser.GetMethod() == "POST" && m_parser.GetHeader(HttpParser::HEADER_CONTENT_TYPE) == "application/x-www-form-urlencoded") {
+        m_body.assign(m_parser.GetBody().data(), m_parser.GetBody().size());
         ParseFromUrlencoded();
         if (DEFAULT_HTML_TAG.count(m_path) == 1) {
             int tag = DEFAULT_HTML_TAG.at(m_path);
@@ -4,10 +4,11 @@
 #include "../buffer/buffer.h"
 #include "../utils/log.h"
 #include "../utils/sql_connector.h"
+#include "http_parser.h"
 #include <cerrno>
 #include <mysql/mysql.h>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -36,52 +37,130 @@
  */
 
 /**
- * 用于处理http请求报文的类，不包含读缓冲，目的是通过读取读缓冲的数据并解析，将请求中的属性一一保存下来
+ * 用于处理http请求报文的类，不包含读缓冲，目的是通过读取读缓冲的数据并解析，将请求中的属性一一保存下来。
+ * 报文的解析由HttpParser完成，方法、版本与请求头都直接指向读缓冲，在下一次读取之前有效
  */
 class HttpRequest {
 public:
-    enum HttpCheckState {
-        CHECK_STATE_REQUESTLINE, // 正在分析请求行
-        CHECK_STATE_HEADER, // 正在分析头部字段
-        CHECK_STATE_BODY, // 正在分析请求体
-        CHECK_STATE_FINISH // 分析完毕
-    };
+    static const size_t MAX_HEAD_SIZE = 8192; // 请求行与请求头的最大长度
+    static size_t g_body_memory_limit; // 请求体留在读缓冲中的最大长度，登记了处理者的路径上更长的请求体边读边写入临时文件，其他路径应答413
+    static size_t g_body_max_size; // 请求体的最大长度，更长时不再接收，应答413
+    static size_t g_chunk_max_size; // 分块编码的请求体中单个分块的最大长度，更长时应答413
+    static std::string g_spill_dir; // 存放请求体临时文件的目录
+
+    /**
+     * 登记path的请求体由处理者自行读取(见HttpConnector::AddBodyRoute)。只有登记过的路径接收超过g_body_memory_limit的请求体，
+     * 其他路径在请求头中的长度(或分块解码出的长度)超过该值时立即应答413，不再接收请求体；应在服务启动之前登记
+     */
+    static void AddBodyConsumer(const std::string& path) { g_body_consumers.insert(path); }
+
     HttpRequest() { Init(); }
-    ~HttpRequest() = default;
+    ~HttpRequest() { Init(); }
     /**
-     * 重置解析状态以及初始化保存的请求报文属性
+     * 重置解析状态以及初始化保存的请求报文属性，关闭请求体的临时文件
      */
     void Init();
 
     /**
-     * 解析请求的主方法:从读缓冲中读入内容，以\r\n作为行分割，分别解析请求的3个部分
+     * 解析请求的主方法:解析读缓冲中的一个请求，补全要访问的文件路径，处理POST上来的表单。
+     * len为RequestLength返回的本请求长度，无论解析成功与否都从buff中取走len字节，其后流水线上的请求留在buff中，
+     * 并从下一个请求的开头重新扫描。解析失败时由GetErrorCode给出应答的状态码
+     */
+    bool Parse(Buffer& buff, size_t len);
+    /**
+     * 返回读缓冲开头的完整请求(请求头及Content-Length指定或分块编码的请求体)在读缓冲中的长度，不完整时返回0；
+     * 超过MAX_HEAD_SIZE仍未找到请求头结尾时返回全部长度，交给Parse判为错误请求。
+     * 请求被拆成多段到达时，每次只扫描新读入的字节：已扫描的长度与找到的请求头、请求体长度保存在对象中，
+     * 记录的是相对请求开头的偏移，读缓冲移动数据后仍然有效。
+     * 分块编码(Transfer-Encoding: chunked)的请求体随读随在读缓冲中原地解码：分块的数据前移接在请求头之后，
+     * 分块大小行等框架从读缓冲中删除，完整时读缓冲中的请求与普通请求相同。
+     * 请求体超过g_body_memory_limit时，已到达(解码)的部分从读缓冲移入临时文件，读缓冲中只留请求头，因此每次读取后都应调用
+     */
+    size_t RequestLength(Buffer& buff);
+    /**
+     * RequestLength已确认完整的请求在读缓冲中的长度，不再扫描读缓冲，应在RequestLength返回非0之后调用
      */
-    bool Parse(Buffer& buff);
+    size_t BufferedLength() const;
+    /**
+     * 与RequestLength相同，但不保存扫描状态，每次从头扫描，也不移出请求体；用于查看流水线上其后的请求，
+     * 分块编码的请求须解码后才知道长度，返回0
+     */
+    static size_t ScanLength(const char* begin, const char* end);
 
-    std::string GetPath() const { return m_path; }
-    std::string GetMethod() const { return m_method; }
-    std::string GetVersion() const { return m_version; }
+    const std::string& GetPath() const { return m_path; }
+    std::string_view GetMethod() const { return m_parser.GetMethod(); }
+    std::string_view GetVersion() const { return m_parser.GetVersion(); }
     /**
      * 返回Post请求体中的内容
      */
     std::string GetPost(const std::string& key);
     bool IsKeepAlive() const;
+    /**
+     * 请求体写入临时文件时返回其fd(已取消链接，读写位置在末尾)，请求体在读缓冲中时返回-1；在下一个请求解析之前有效
+     */
+    int GetBodyFd() const { return m_body_fd; }
+    /**
+     * 请求体在读缓冲中时返回请求体，写入临时文件时为空；与请求行、请求头一样在下一次读取之前有效
+     */
+    std::string_view GetBody() const { return m_parser.GetBody(); }
+    /**
+     * 请求体的长度，无论在读缓冲中还是在临时文件中
+     */
+    size_t GetBodyLength() const { return m_body_size; }
+    /**
+     * Parse失败时应答的状态码
+     */
+    int GetErrorCode() const { return m_error; }
 
 private:
-    /* 下面的3个方法被解析请求的主方法Parse调用以分别解析请求的3个部分 */
+    /* 分块编码请求体的解码状态 */
+    enum ChunkState {
+        CHUNK_SIZE, // 分块大小(十六进制)
+        CHUNK_EXT, // 分块扩展，忽略到行尾
+        CHUNK_SIZE_LF, // 分块大小行的\n
+        CHUNK_DATA, // 分块数据
+        CHUNK_DATA_CR, // 分块数据后的\r\n
+        CHUNK_DATA_LF,
+        CHUNK_TRAILER, // 最后一个分块之后，一行的开头：空行结束请求，否则为trailer
+        CHUNK_TRAILER_LINE, // trailer，忽略到行尾
+        CHUNK_END_LF, // 结束空行的\n
+        CHUNK_DONE,
+    };
 
     /**
-     * 解析请求行的入口方法，返回true代表解析成功，返回false代表本行不是请求行的正确格式
+     * 在请求头[begin, headEnd)中查找Content-Length与Transfer-Encoding，返回Content-Length指定的请求体长度，
+     * 分块编码时返回0并置chunked；两者同时出现或值不合法时返回SIZE_MAX
+     */
+    static size_t BodyLength(const char* begin, const char* headEnd, bool* chunked);
+    /**
+     * 补全要访问的文件路径(如/index补全为/index.html)
+     */
+    static void CompletePath(std::string& path);
+    /**
+     * 请求行[begin, headEnd)中的路径是否登记了请求体的处理者
+     */
+    static bool HasBodyConsumer(const char* begin, const char* headEnd);
+    /**
+     * 重置RequestLength的扫描状态，不关闭临时文件
+     */
+    void ResetFrame();
+    /**
+     * 从上次停下的位置继续解码读缓冲中已到达的分块，格式错误或超过长度限制时置m_frame_error并返回false
+     */
+    bool DecodeChunked(Buffer& buff);
+    /**
+     * 在g_spill_dir中创建已取消链接的临时文件，失败时返回-1
      */
-    bool ParseRequestLine(const std::string& line);
+    static int OpenSpillFile();
     /**
-     * 解析一行请求头的入口方法，返回true代表解析成功，返回false代表本行不是请求头的正确格式
+     * 把读缓冲中已到达的请求体写入临时文件并从读缓冲中删除，写入失败时返回false
      */
-    bool ParseHeader(const std::string& line);
+    bool Spill(Buffer& buff);
+
     /**
-     *  解析请求体的入口方法，返回true代表解析成功，返回false代表本行不是请求体的正确格式
+     *  解析请求体的入口方法，返回true代表解析成功，返回false代表请求体格式错误
      */
-    bool ParseBody(const std::string& line);
+    bool ParseBody();
 
     /**
      * 解析post的数据
@@ -93,15 +172,31 @@ private:
      */
     bool UserVerify(const std::string& name, const std::string& pwd, bool is_login);
 
-    HttpCheckState m_state; // 当前解析的状态
-    std::string m_method, m_version, m_path; // 解析后请求行的三个属性之一
-    std::unordered_map<std::string, std::string> m_header; // 解析后本请求的头部属性，属性较多且可选，因此以map保存
-    std::string m_body; // 保存的请求体
+    /* RequestLength的扫描状态，都是相对请求开头的偏移 */
+    size_t m_scanned; // 已扫描过、不含请求头结尾的字节数
+    size_t m_head_len; // 请求头(含空行)的长度，尚未找到结尾时为0
+    size_t m_body_len; // Content-Length指定的请求体长度，分块编码时为已解码的长度
+    bool m_chunked; // 请求体是否为分块编码
+    ChunkState m_chunk_state;
+    size_t m_chunk_left; // 当前分块剩余的数据长度，读分块大小时为已读到的值
+    size_t m_chunk_line; // 当前分块大小行或全部trailer已读的长度
+    size_t m_spilled; // 已写入临时文件的请求体长度
+    int m_spill_fd = -1; // 正在接收的请求体的临时文件
+    int m_frame_error; // 接收时发现的错误对应的状态码，0为没有错误
+
+    int m_body_fd = -1; // 已解析的请求的请求体临时文件
+    size_t m_body_size; // 已解析的请求的请求体长度
+    int m_error; // 解析失败时应答的状态码
+
+    HttpParser m_parser; // 解析出的请求行与请求头
+    std::string m_path; // 补全后要访问的文件路径，复用其容量
+    std::string m_body; // 保存的请求体，解析表单时会原地修改，因此复制一份
     std::unordered_map<std::string, std::string> m_post; // 解析后本请求的请求体中post上来的属性
 
     // 下面二者用来补全要访问的文件名(如path = /index，则需补全为/index.html)
     static const std::unordered_set<std::string> DEFAULT_HTML;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
+    static std::unordered_set<std::string> g_body_consumers; // 登记了请求体处理者的路径
 };
 
 #endif // _HTTP_REQUEST_H_
@@ -1,5 +1,8 @@
 #include "http_response.h"
 #include "http_connector.h"
+#include <cstdio>
+
+bool HttpResponse::g_use_sendfile = false;
 
 const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
     { ".html", "text/html" },
@@ -28,6 +31,7 @@ const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 413, "Payload Too Large" },
     { -1, "Server Initing" } // 内部状态，不应返回
 };
 
@@ -35,27 +39,25 @@ const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 413, "/413.html" },
 };
 
-void HttpResponse::Init(const std::string& src_dir, std::string path, bool is_keepalive, int code)
+void HttpResponse::Init(const std::string& src_dir, const std::string& path, bool is_keepalive, int code)
 {
     assert(!src_dir.empty());
-    if (m_file) {
-        UnmapFile();
-    }
     m_code = code;
     m_is_keepalive = is_keepalive;
     m_path = path;
     m_src_dir = src_dir;
     m_file = nullptr;
-    m_file_stat = { 0 };
 }
 
 void HttpResponse::MakeResponse(Buffer& buff)
 {
-    if (stat((m_src_dir + m_path).data(), &m_file_stat) < 0 || S_ISDIR(m_file_stat.st_mode)) { // 判断请求的资源文件是否存在以及是否有权限访问
+    if (m_code >= 400) { // 请求本身有错误(解析失败时没有路径)，直接使用错误页
+    } else if (!(m_file = FileCache::GetInstance().Get(m_src_dir + FileCache::Normalize(m_path), !g_use_sendfile))) { // 判断请求的资源文件是否存在以及是否有权限访问
         m_code = 404;
-    } else if (!(m_file_stat.st_mode & S_IROTH)) {
+    } else if (!(m_file->st.st_mode & S_IROTH)) {
         m_code = 403;
     } else if (m_code == -1) {
         m_code = 200;
@@ -66,11 +68,58 @@ void HttpResponse::MakeResponse(Buffer& buff)
     AddContent(buff); // 添加响应体
 }
 
+void HttpResponse::MakeStreamResponse(Buffer& buff, bool chunked)
+{
+    m_code = 200;
+    if (!chunked) { // 应答体的结尾只能由关闭连接表示
+        m_is_keepalive = false;
+    }
+    AddStateLine(buff);
+    AddHeader(buff);
+    buff.Append(chunked ? "Transfer-Encoding: chunked\r\n\r\n" : "\r\n");
+}
+
+bool HttpResponse::AppendChunk(Buffer& buff, const BodyProducer& producer, bool chunked)
+{
+    if (!chunked) {
+        size_t before = buff.ReadableBytes();
+        bool more = producer(buff);
+        if (more && buff.ReadableBytes() == before) { // 违反约定的空段，视为结束，避免写出方反复调用或得到空的一批
+            LOG_WARN("Stream producer returned an empty piece, end the stream");
+            return false;
+        }
+        return more;
+    }
+    const char SIZE_LINE[] = "00000000\r\n"; // 分块大小允许前导0，预留8位十六进制数
+    const size_t SIZE_LEN = sizeof(SIZE_LINE) - 1;
+    size_t sizePos = buff.ReadableBytes(); // 记录偏移，producer追加时buff可能扩容
+    buff.Append(SIZE_LINE, SIZE_LEN);
+    bool more = producer(buff);
+    size_t len = buff.ReadableBytes() - sizePos - SIZE_LEN;
+    assert(len <= 0xffffffff);
+    if (len == 0) { // 空的分块会被当作结束分块，去掉预留的大小行；未结束的空段违反约定，视为结束
+        buff.Erase(sizePos, SIZE_LEN);
+        if (more) {
+            LOG_WARN("Stream producer returned an empty piece, end the stream");
+            more = false;
+        }
+    } else {
+        char hex[9];
+        snprintf(hex, sizeof(hex), "%08zx", len);
+        memcpy(buff.GetReadPtr() + sizePos, hex, 8);
+        buff.Append("\r\n", 2);
+    }
+    if (!more) {
+        buff.Append("0\r\n\r\n", 5);
+    }
+    return more;
+}
+
 void HttpResponse::ErrorHtml()
 {
     if (CODE_PATH.count(m_code) == 1) {
         m_path = CODE_PATH.at(m_code);
-        stat((m_src_dir + m_path).data(), &m_file_stat);
+        m_file = FileCache::GetInstance().Get(m_src_dir + m_path, !g_use_sendfile);
     }
 }
 
@@ -97,52 +146,30 @@ void HttpResponse::AddHeader(Buffer& buff)
     } else {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType() + "\r\n");
+    buff.Append("Content-type: " + (m_file ? m_file->mime : GetFileType(m_path)) + "\r\n");
 }
 
 void HttpResponse::AddContent(Buffer& buff)
 {
-    /* 由于前面以及已经更改了path，因此直接映射该文件就行 */
-    int src_fd = open((m_src_dir + m_path).data(), O_RDONLY);
-    if (src_fd < 0) {
+    /* 由于前面已经更改了path并取得了对应的缓存条目，文件已打开，mmap模式下已映射到内存 */
+    if (!m_file || m_file->fd < 0 || (!g_use_sendfile && !m_file->map && m_file->st.st_size > 0)) {
+        m_file = nullptr;
         ErrorContent(buff, "File Not Found!"); // 连出错网页都打不开，直接写入错误信息
         return;
     }
-
-    /* 将文件映射到内存提高文件的访问速度，MAP_PRIVATE 建立一个写入时拷贝的私有映射，
-    mmap 将一个文件或者其它对象映射进内存。文件被映射到多个页上，如果文件的大小不是所有页的大小之和，最后一个页不被使用的空间将会清零，
-    munmap 执行相反的操作，删除特定地址区域的对象映射。
-    */
-    LOG_DEBUG("file path %s", (m_src_dir + m_path).data());
-    int* mm_ret = (int*)mmap(nullptr, m_file_stat.st_size, PROT_READ, MAP_PRIVATE, src_fd, 0);
-    if (*mm_ret == -1) {
-        ErrorContent(buff, "File Not Found!");
-        return;
-    }
-    m_file = (char*)mm_ret;
-    close(src_fd);
-    buff.Append("Content-length: " + std::to_string(m_file_stat.st_size) + "\r\n\r\n");
+    LOG_DEBUG("file path %s", m_file->path.data());
+    buff.Append("Content-length: " + std::to_string(m_file->st.st_size) + "\r\n\r\n");
 }
 
-void HttpResponse::UnmapFile()
+const std::string& HttpResponse::GetFileType(const std::string& path)
 {
-    if (m_file) {
-        munmap(m_file, m_file_stat.st_size);
-        m_file = nullptr;
-    }
-}
-
-std::string HttpResponse::GetFileType()
-{
-    std::string::size_type idx = m_path.find_last_of('.');
-    if (idx == std::string::npos) {
-        return "text/plain";
-    }
-    std::string suffix = m_path.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.at(suffix);
+    static const std::string TEXT_PLAIN = "text/plain";
+    std::string::size_type idx = path.find_last_of("./");
+    if (idx == std::string::npos || path[idx] == '/') {
+        return TEXT_PLAIN;
     }
-    return "text/plain";
+    auto it = SUFFIX_TYPE.find(path.substr(idx));
+    return it == SUFFIX_TYPE.end() ? TEXT_PLAIN : it->second;
 }
 
 void HttpResponse::ErrorContent(Buffer& buff, std::string message) const
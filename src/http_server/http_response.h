@@ -2,6 +2,7 @@
 #define _HTTP_RESPONSE_H
 
 #include <fcntl.h>
+#include <functional>
 #include <string>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -9,43 +10,71 @@
 #include <unordered_map>
 
 #include "../buffer/buffer.h"
+#include "file_cache.h"
 
 /**
  * 用于生成http应答报文的类，不包含写缓冲，目的是通过解析结果生成应答报文，并写入写缓冲
  */
 class HttpResponse {
 public:
+    /**
+     * 流式应答体的产生者：每次调用向out追加一段应答体，返回false表示应答体已全部产生。
+     * 写出方只在此前产生的数据写出后才再次调用，产生的速度因此受对端接收速度的限制；在Reactor线程中调用，不应阻塞，
+     * 每次调用应追加数据或者结束，暂时没有数据时不要返回空段
+     */
+    using BodyProducer = std::function<bool(Buffer& out)>;
+
+    static bool g_use_sendfile; // 文件内容用sendfile从页缓存直接发送，不再映射到内存
+
     HttpResponse()
         : m_code(-1)
         , m_path("")
         , m_src_dir("")
         , m_is_keepalive(false)
-        , m_file(nullptr)
-        , m_file_stat({ 0 })
     {
     }
-    ~HttpResponse() { UnmapFile(); }
     /**
      * 根据request解析的结果，将参数传递至response，并重置HttpResponse中应写入的内容
      */
-    void Init(const std::string& src_dir, std::string path, bool is_Keepalive, int code);
+    void Init(const std::string& src_dir, const std::string& path, bool is_Keepalive, int code);
 
     /**
      * 主入口函数，根据解析结果生成应答报文并写入buff
      */
     void MakeResponse(Buffer& buff);
+    /**
+     * 生成流式应答的状态行与头部，应答体随后由AppendChunk逐段追加：chunked为true时使用分块编码(HTTP/1.1)，
+     * 否则不带长度，以关闭连接标志应答体结束(HTTP/1.0)
+     */
+    void MakeStreamResponse(Buffer& buff, bool chunked);
+    /**
+     * 调用一次producer，把产生的一段应答体作为一个分块追加到buff：先预留定长的分块大小行，产生后再填入长度，
+     * producer直接写入buff，不再复制。producer结束时追加结束分块并返回false；producer未追加数据却未结束时同样视为结束
+     */
+    static bool AppendChunk(Buffer& buff, const BodyProducer& producer, bool chunked);
 
-    void UnmapFile();
     /**
-     * 获取资源文件
+     * 获取资源文件在内存中的映射，sendfile模式下为空
      */
-    char* GetFile() { return m_file; }
-    size_t FileLen() const { return m_file_stat.st_size; }
+    char* GetFile() const { return m_file ? m_file->map : nullptr; }
+    /**
+     * sendfile模式下资源文件的fd，不是该模式或没有文件时为-1；fd由所有连接共享，发送时应使用自己的偏移
+     */
+    int GetFileFd() const { return m_file && g_use_sendfile ? m_file->fd : -1; }
+    /**
+     * 交出资源文件缓存条目的引用，写出方持有到文件内容写完，用于流水线上多个应答的文件同时等待写出
+     */
+    FileCache::EntryPtr ReleaseFile() { return std::move(m_file); }
+    size_t FileLen() const { return m_file ? m_file->st.st_size : 0; }
     /**
      * 向buff直接写入出错信息
      */
     void ErrorContent(Buffer& buff, std::string message) const;
     int GetCode() const { return m_code; }
+    /**
+     * 由文件后缀得到Content-type
+     */
+    static const std::string& GetFileType(const std::string& path);
 
 private:
     /* 下面三个函数分别用来填充应答报文的三个部分 */
@@ -53,26 +82,20 @@ private:
     void AddStateLine(Buffer& buff);
     void AddHeader(Buffer& buff);
     /**
-     * 与添加状态行和头部不同，添加应答体是将转文件映射到内存中，并设置m_file指针，等待后续writev直接写出
+     * 与添加状态行和头部不同，应答体不复制到buff，文件的映射(sendfile模式下为fd)由文件缓存提供，等待后续writev或sendfile直接写出
      */
     void AddContent(Buffer& buff);
     /**
      * 如果有的话，设置path指向错误相应的html界面
      */
     void ErrorHtml();
-    /**
-     * 获取资源文件类型
-     */
-    std::string GetFileType();
-
     int m_code; // 状态码
     bool m_is_keepalive; // 是否长连接
 
     std::string m_path; // 应答报文指向的资源路径
     std::string m_src_dir; // 根目录
 
-    char* m_file; // 实际的资源文件在内存中的位置
-    struct stat m_file_stat; // 资源文件状态
+    FileCache::EntryPtr m_file; // 资源文件的缓存条目，包含状态、映射与fd
 
     static const std::unordered_map<std::string, std::string> SUFFIX_TYPE; // 文件类型与对应的应答头的映射
     static const std::unordered_map<int, std::string> CODE_STATUS; // 状态码
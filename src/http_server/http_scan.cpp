@@ -0,0 +1,310 @@
+#include "http_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86
+#endif
+
+/* 标量实现：作为不支持SIMD时的实现，也用于处理SIMD内核剩下的不足一个向量的尾部 */
+
+static const char* FindByteScalar(const char* begin, const char* end, char c)
+{
+    for (; begin < end; begin++) {
+        if (*begin == c) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+/**
+ * lf为'\n'的位置，判断它与之前的字节是否构成\r\n，返回\r的位置或nullptr
+ */
+static inline const char* CRLFAt(const char* begin, const char* lf)
+{
+    return lf > begin && lf[-1] == '\r' ? lf - 1 : nullptr;
+}
+
+/**
+ * lf为'\n'的位置，判断它与之前的字节是否构成\r\n\r\n，返回第一个\r的位置或nullptr
+ */
+static inline const char* HeadEndAt(const char* begin, const char* lf)
+{
+    return lf - begin >= 3 && lf[-1] == '\r' && lf[-2] == '\n' && lf[-3] == '\r' ? lf - 3 : nullptr;
+}
+
+/**
+ * lf为'\n'的位置，判断其后是否紧跟空行\r\n，即它结束了最后一行请求头
+ */
+static inline bool EndsHead(const char* lf, const char* end)
+{
+    return end - lf > 2 && lf[1] == '\r' && lf[2] == '\n';
+}
+
+/* 下面的From函数从pos开始扫描，向前检查时不越过begin */
+
+static const char* FindCRLFFrom(const char* begin, const char* pos, const char* end)
+{
+    for (; pos < end; pos++) {
+        const char* crlf = *pos == '\n' ? CRLFAt(begin, pos) : nullptr;
+        if (crlf) {
+            return crlf;
+        }
+    }
+    return end;
+}
+
+static const char* FindHeadEndFrom(const char* begin, const char* pos, const char* end)
+{
+    for (; pos < end; pos++) {
+        const char* headEnd = *pos == '\n' ? HeadEndAt(begin, pos) : nullptr;
+        if (headEnd) {
+            return headEnd;
+        }
+    }
+    return end;
+}
+
+static const char* FindCRLFScalar(const char* begin, const char* end)
+{
+    return FindCRLFFrom(begin, begin, end);
+}
+
+static const char* FindHeadEndScalar(const char* begin, const char* end)
+{
+    return FindHeadEndFrom(begin, begin, end);
+}
+
+/**
+ * 从pos开始扫描，偏移相对begin，out中已有count个
+ */
+static size_t IndexScalarFrom(const char* begin, const char* pos, const char* end, uint32_t* out, size_t count, size_t max)
+{
+    for (; pos < end && count < max; pos++) {
+        if (*pos == '\n' || *pos == ':') {
+            out[count++] = static_cast<uint32_t>(pos - begin);
+            if (*pos == '\n' && EndsHead(pos, end)) {
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+static size_t IndexScalar(const char* begin, const char* end, uint32_t* out, size_t max)
+{
+    return IndexScalarFrom(begin, begin, end, out, 0, max);
+}
+
+#ifdef HTTP_SCAN_X86
+
+/* SSE2内核：x86-64的基础指令集，一次比较16个字节 */
+
+static const char* FindByteSse2(const char* begin, const char* end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    for (; p + 16 <= end; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindByteScalar(p, end, c);
+}
+
+/* \r\n与\r\n\r\n都以'\n'结尾：向量比较只找'\n'，每个候选位置再检查它前面的字节，请求头中每行只有一个候选 */
+
+static const char* FindCRLFSse2(const char* begin, const char* end)
+{
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 16 <= end; p += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), lf));
+        for (; mask; mask &= mask - 1) {
+            if (const char* crlf = CRLFAt(begin, p + __builtin_ctz(mask))) {
+                return crlf;
+            }
+        }
+    }
+    return FindCRLFFrom(begin, p, end);
+}
+
+static const char* FindHeadEndSse2(const char* begin, const char* end)
+{
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 16 <= end; p += 16) {
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), lf));
+        for (; mask; mask &= mask - 1) {
+            if (const char* headEnd = HeadEndAt(begin, p + __builtin_ctz(mask))) {
+                return headEnd;
+            }
+        }
+    }
+    return FindHeadEndFrom(begin, p, end);
+}
+
+static size_t IndexSse2(const char* begin, const char* end, uint32_t* out, size_t max)
+{
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i colon = _mm_set1_epi8(':');
+    const char* p = begin;
+    size_t count = 0;
+    for (; p + 16 <= end; p += 16) {
+        while (p + 64 <= end) { // 长Cookie等行中大段没有结构字符，先按64字节快速跳过
+            __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+            __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+            __m128i b3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b0, lf), _mm_cmpeq_epi8(b0, colon)),
+                                       _mm_or_si128(_mm_cmpeq_epi8(b1, lf), _mm_cmpeq_epi8(b1, colon)));
+            hit = _mm_or_si128(hit, _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b2, lf), _mm_cmpeq_epi8(b2, colon)),
+                                                 _mm_or_si128(_mm_cmpeq_epi8(b3, lf), _mm_cmpeq_epi8(b3, colon))));
+            if (_mm_movemask_epi8(hit)) {
+                break;
+            }
+            p += 64;
+        }
+        if (p + 16 > end) {
+            break;
+        }
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lf), _mm_cmpeq_epi8(block, colon)));
+        for (; mask; mask &= mask - 1) { // 逐个取出置位的字节
+            const char* pos = p + __builtin_ctz(mask);
+            if (count == max) {
+                return count;
+            }
+            out[count++] = static_cast<uint32_t>(pos - begin);
+            if (*pos == '\n' && EndsHead(pos, end)) { // 请求头到此结束，不再扫描请求体
+                return count;
+            }
+        }
+    }
+    return IndexScalarFrom(begin, p, end, out, count, max);
+}
+
+/* AVX2内核：一次比较32个字节，只在运行时检测到CPU支持AVX2后才会调用 */
+
+__attribute__((target("avx2"))) static const char* FindByteAvx2(const char* begin, const char* end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for (; p + 32 <= end; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return FindByteScalar(p, end, c);
+}
+
+__attribute__((target("avx2"))) static const char* FindCRLFAvx2(const char* begin, const char* end)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 32 <= end; p += 32) {
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), lf));
+        for (; mask; mask &= mask - 1) {
+            if (const char* crlf = CRLFAt(begin, p + __builtin_ctz(mask))) {
+                return crlf;
+            }
+        }
+    }
+    return FindCRLFFrom(begin, p, end);
+}
+
+__attribute__((target("avx2"))) static const char* FindHeadEndAvx2(const char* begin, const char* end)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    for (; p + 32 <= end; p += 32) {
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), lf));
+        for (; mask; mask &= mask - 1) {
+            if (const char* headEnd = HeadEndAt(begin, p + __builtin_ctz(mask))) {
+                return headEnd;
+            }
+        }
+    }
+    return FindHeadEndFrom(begin, p, end);
+}
+
+__attribute__((target("avx2"))) static size_t IndexAvx2(const char* begin, const char* end, uint32_t* out, size_t max)
+{
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const char* p = begin;
+    size_t count = 0;
+    for (; p + 32 <= end; p += 32) {
+        while (p + 64 <= end) { // 与SSE2内核相同，先按64字节快速跳过
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+            __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b0, lf), _mm256_cmpeq_epi8(b0, colon)),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(b1, lf), _mm256_cmpeq_epi8(b1, colon)));
+            if (!_mm256_testz_si256(hit, hit)) {
+                break;
+            }
+            p += 64;
+        }
+        if (p + 32 > end) {
+            break;
+        }
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(block, lf), _mm256_cmpeq_epi8(block, colon));
+        unsigned mask = _mm256_movemask_epi8(hit);
+        for (; mask; mask &= mask - 1) {
+            const char* pos = p + __builtin_ctz(mask);
+            if (count == max) {
+                return count;
+            }
+            out[count++] = static_cast<uint32_t>(pos - begin);
+            if (*pos == '\n' && EndsHead(pos, end)) {
+                return count;
+            }
+        }
+    }
+    return IndexScalarFrom(begin, p, end, out, count, max);
+}
+
+#endif // HTTP_SCAN_X86
+
+HttpScan::Isa HttpScan::Detect()
+{
+#ifdef HTTP_SCAN_X86
+    __builtin_cpu_init(); // 可能在其他全局对象的构造函数中被调用
+    if (__builtin_cpu_supports("avx2")) {
+        return ISA_AVX2;
+    }
+    return ISA_SSE2;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+HttpScan::Isa HttpScan::SetIsa(Isa isa)
+{
+    Isa supported = Detect();
+    s_kernels = Select(isa < supported ? isa : supported);
+    return s_kernels->isa;
+}
+
+const HttpScan::Kernels* HttpScan::Select(Isa isa)
+{
+    static const Kernels SCALAR = { ISA_SCALAR, FindByteScalar, FindCRLFScalar, FindHeadEndScalar, IndexScalar };
+#ifdef HTTP_SCAN_X86
+    static const Kernels SSE2 = { ISA_SSE2, FindByteSse2, FindCRLFSse2, FindHeadEndSse2, IndexSse2 };
+    static const Kernels AVX2 = { ISA_AVX2, FindByteAvx2, FindCRLFAvx2, FindHeadEndAvx2, IndexAvx2 };
+    if (isa == ISA_AVX2) {
+        return &AVX2;
+    }
+    if (isa == ISA_SSE2) {
+        return &SSE2;
+    }
+#endif
+    return &SCALAR;
+}
+
+const HttpScan::Kernels* HttpScan::s_kernels = HttpScan::Select(HttpScan::Detect());
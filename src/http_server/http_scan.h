@@ -0,0 +1,68 @@
+#ifndef _HTTP_SCAN_H_
+#define _HTTP_SCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 扫描请求头的SIMD内核：一次比较16(SSE2)或32(AVX2)个字节，查找\r\n、\r\n\r\n、':'与空格。
+ * 启动时按CPU支持的指令集选择实现，AVX2内核以函数级target属性编译，不需要对整个程序开启-mavx2；非x86平台使用逐字节的标量实现。
+ */
+class HttpScan {
+public:
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2,
+    };
+
+    /**
+     * 返回[begin, end)中第一个c的位置，没有时返回end
+     */
+    static const char* FindByte(const char* begin, const char* end, char c) { return s_kernels->find_byte(begin, end, c); }
+    /**
+     * 返回[begin, end)中第一个\r\n的位置，没有时返回end
+     */
+    static const char* FindCRLF(const char* begin, const char* end) { return s_kernels->find_crlf(begin, end); }
+    /**
+     * 返回[begin, end)中第一个\r\n\r\n(请求头的结尾)的位置，没有时返回end
+     */
+    static const char* FindHeadEnd(const char* begin, const char* end) { return s_kernels->find_head_end(begin, end); }
+    /**
+     * 一次扫描[begin, end)，把其中'\n'与':'相对begin的偏移按顺序写入out，最多max个，返回写入的个数。
+     * 遇到其后紧跟空行\r\n的'\n'(最后一行请求头的结尾)时记录它并停止，不扫描请求体；
+     * 返回max时其后可能还有未记录的，应从已处理的位置起再次扫描
+     */
+    static size_t IndexStructural(const char* begin, const char* end, uint32_t* out, size_t max)
+    {
+        return s_kernels->index_structural(begin, end, out, max);
+    }
+
+    /**
+     * 当前CPU支持的最高指令集
+     */
+    static Isa Detect();
+    /**
+     * 当前使用的指令集
+     */
+    static Isa GetIsa() { return s_kernels->isa; }
+    /**
+     * 指定使用的指令集，超过CPU支持的指令集时使用支持的最高指令集，返回实际使用的指令集；用于对比测试，应在启动其他线程之前调用
+     */
+    static Isa SetIsa(Isa isa);
+
+private:
+    struct Kernels {
+        Isa isa;
+        const char* (*find_byte)(const char* begin, const char* end, char c);
+        const char* (*find_crlf)(const char* begin, const char* end);
+        const char* (*find_head_end)(const char* begin, const char* end);
+        size_t (*index_structural)(const char* begin, const char* end, uint32_t* out, size_t max);
+    };
+
+    static const Kernels* Select(Isa isa);
+
+    static const Kernels* s_kernels; // 当前使用的内核
+};
+
+#endif // _HTTP_SCAN_H_
@@ -1,14 +1,15 @@
 #include "http_server.h"
 #include "../utils/json.h" // https://github.com/nlohmann/json/tree/develop/single_include/nlohmann/json.hpp
-#include "../utils/timer.h"
 #include "http_connector.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <fstream>
 #include <memory>
 #include <sys/epoll.h>
 // using json = nlohmann::json;
-// static const std::string CONFIG_FILEPATH = "../conf_http_server.json";
+
+const std::string HttpServer::DEFAULTCONFIG_FILEPATH = "./src/utils/conf_http_server.json";
 
 HttpServer::HttpServer(int port, int timeout, bool linger, int thread_num,
     bool open_log, int sql_port, const char* sql_user, const char* sql_pwd,
@@ -17,9 +18,17 @@ HttpServer::HttpServer(int port, int timeout, bool linger, int thread_num,
     , m_is_listen(false)
     , m_timeout(timeout)
     , m_linger(linger)
-    , m_epoll(std::make_unique<Epoll>())
-    , m_threadpool(std::make_unique<ThreadPool>(thread_num))
-    , m_timer(std::make_unique<Timer>())
+    , m_reactor_num(0)
+    , m_backend(Poller::BACKEND_EPOLL)
+    , m_pool_mode(ThreadPool::MODE_WORK_STEALING)
+    , m_pool_max_threads(32)
+    , m_pool_grow_wait_ms(10)
+    , m_pool_idle_timeout_ms(30000)
+    , m_log_cpu(-1)
+    , m_run_to_completion(false)
+    , m_conn_affinity(false)
+    , m_slab(std::make_unique<ConnSlab>(MAX_FD))
+    , m_next_reactor(0)
 {
     m_src_dir = getcwd(nullptr, 256);
     assert(m_src_dir);
@@ -35,6 +44,13 @@ HttpServer::HttpServer(int port, int timeout, bool linger, int thread_num,
     SqlConnector::GetInstance().InitPool("localhost", sql_port, sql_user, sql_pwd, dbName, sqlconnpool_num);
 
     LOG_INFO("========== Server init ==========");
+    SetPropertyFromFile(); // 配置文件中的属性覆盖默认值
+    Log::GetInstance()->SetCpu(m_log_cpu);
+    m_threadpool = std::make_unique<ThreadPool>(thread_num, m_pool_mode, m_worker_cpus);
+    if (m_pool_mode == ThreadPool::MODE_ELASTIC) {
+        m_threadpool->SetElastic(m_pool_max_threads, m_pool_grow_wait_ms, m_pool_idle_timeout_ms);
+    }
+    InitReactors();
     if (!InitListen()) {
         m_is_listen = false;
         LOG_ERROR("========== Server init error!==========");
@@ -43,39 +59,80 @@ HttpServer::HttpServer(int port, int timeout, bool linger, int thread_num,
     LOG_INFO("Port:%d, OpenLinger: %s", m_port, m_linger ? "true" : "false");
     LOG_INFO("srcDir: %s", HttpServer::m_src_dir);
     LOG_INFO("Timeout: %d", m_timeout);
-    LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", SqlConnector::GetInstance().GetPoolSize(), thread_num);
+    LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, ThreadPool mode: %s", SqlConnector::GetInstance().GetPoolSize(), thread_num,
+        m_pool_mode == ThreadPool::MODE_MPMC_RING ? "mpmc_ring" : m_pool_mode == ThreadPool::MODE_ELASTIC ? "elastic" : "work_stealing");
+    LOG_INFO("Reactor num: %d, Event backend: %s, Run to completion: %s, Conn affinity: %s", m_reactor_num,
+        m_backend == Poller::BACKEND_IO_URING ? "io_uring" : "epoll", m_run_to_completion ? "true" : "false",
+        m_conn_affinity ? "true" : "false");
+    LOG_INFO("Static file send: %s, File cache entries: %zu, File cache validate: %lldms", HttpResponse::g_use_sendfile ? "sendfile" : "mmap",
+        FileCache::g_max_entries, static_cast<long long>(FileCache::g_validate_ms));
+    LOG_INFO("Body memory limit: %zu, Body max size: %zu, Chunk max size: %zu, Body spill dir: %s", HttpRequest::g_body_memory_limit,
+        HttpRequest::g_body_max_size, HttpRequest::g_chunk_max_size, HttpRequest::g_spill_dir.c_str());
 }
 
 void HttpServer::Start()
 {
-    int timeout = -1; // epoll wait timeout == -1 无事件将阻塞
     m_is_listen = true; // 启动监听
     if (m_is_listen) {
         LOG_INFO("========== Server start ==========");
     }
-    while (m_is_listen) {
-        if (m_timeout > 0) {
-            timeout = m_timer->GetNextTick(); // 获取下一个事件剩余时间
-        }
-        int eventCnt = m_epoll->Wait(timeout);
-        for (int i = 0; i < eventCnt; i++) { // 根据epoll上的事件，转发至对应方法
-            int fd = m_epoll->GetEventFd(i);
-            uint32_t events = m_epoll->GetEvents(i);
-            if (fd == m_listenFd) { // 新客户端连接
-                OnListen();
-            } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) { // 连接异常
-                assert(m_users.count(fd) > 0);
-                CloseConn(&m_users[fd]);
-            } else if (events & EPOLLIN) { // 客户端发送数据
-                assert(m_users.count(fd) > 0);
-                OnRead(&m_users[fd]);
-            } else if (events & EPOLLOUT) { // 服务器发送数据
-                assert(m_users.count(fd) > 0);
-                OnWrite(&m_users[fd]);
-            } else {
-                LOG_ERROR("Unexpected event");
-            }
-        }
+    for (auto& reactor : m_sub_reactors) { // one loop per thread
+        m_reactor_threads.emplace_back([capture0 = reactor.get()] { capture0->Loop(); });
+    }
+    m_main_reactor->Loop(); // 主线程运行主Reactor
+}
+
+bool HttpServer::SetPropertyFromFile(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        LOG_WARN("Config file %s not found, use default property", path.c_str());
+        return false;
+    }
+    nlohmann::json conf = nlohmann::json::parse(in, nullptr, false); // 不抛出异常，解析失败时返回discarded
+    if (conf.is_discarded() || !conf.is_object()) {
+        LOG_ERROR("Config file %s parse error!", path.c_str());
+        return false;
+    }
+    m_reactor_num = std::max(0, conf.value("reactor_num", m_reactor_num));
+    m_backend = Poller::ParseBackend(conf.value("event_backend", std::string("epoll")));
+    std::string poolMode = conf.value("threadpool_mode", std::string("work_stealing"));
+    if (poolMode == "mpmc_ring") {
+        m_pool_mode = ThreadPool::MODE_MPMC_RING;
+    } else if (poolMode == "elastic") {
+        m_pool_mode = ThreadPool::MODE_ELASTIC;
+    } else if (poolMode != "work_stealing") {
+        LOG_WARN("Unknown threadpool mode %s, use work_stealing", poolMode.c_str());
+    }
+    m_pool_max_threads = std::max(0, conf.value("threadpool_max_threads", m_pool_max_threads));
+    m_pool_grow_wait_ms = conf.value("threadpool_grow_wait_ms", m_pool_grow_wait_ms);
+    m_pool_idle_timeout_ms = conf.value("threadpool_idle_timeout_ms", m_pool_idle_timeout_ms);
+    m_reactor_cpus = conf.value("reactor_cpus", m_reactor_cpus);
+    m_worker_cpus = conf.value("worker_cpus", m_worker_cpus);
+    m_log_cpu = conf.value("log_cpu", m_log_cpu);
+    m_run_to_completion = conf.value("run_to_completion", m_run_to_completion);
+    m_conn_affinity = conf.value("conn_affinity", m_conn_affinity);
+    HttpResponse::g_use_sendfile = conf.value("sendfile", HttpResponse::g_use_sendfile);
+    FileCache::g_max_entries = conf.value("file_cache_max_entries", FileCache::g_max_entries);
+    FileCache::g_validate_ms = conf.value("file_cache_validate_ms", FileCache::g_validate_ms);
+    HttpRequest::g_body_memory_limit = conf.value("body_memory_limit", HttpRequest::g_body_memory_limit);
+    HttpRequest::g_body_max_size = conf.value("body_max_size", HttpRequest::g_body_max_size);
+    HttpRequest::g_chunk_max_size = conf.value("chunk_max_size", HttpRequest::g_chunk_max_size);
+    HttpRequest::g_spill_dir = conf.value("body_spill_dir", HttpRequest::g_spill_dir);
+    return true;
+}
+
+void HttpServer::InitReactors()
+{
+    m_main_reactor = std::make_unique<Reactor>(m_timeout, m_threadpool.get(), m_slab.get(), m_backend);
+    m_main_reactor->SetCpu(CpuAffinity::Pick(m_reactor_cpus, 0));
+    m_main_reactor->SetRunToCompletion(m_run_to_completion);
+    m_main_reactor->SetConnAffinity(m_conn_affinity);
+    for (int i = 0; i < m_reactor_num; i++) {
+        m_sub_reactors.emplace_back(std::make_unique<Reactor>(m_timeout, m_threadpool.get(), m_slab.get(), m_backend));
+        m_sub_reactors.back()->SetCpu(CpuAffinity::Pick(m_reactor_cpus, i + 1));
+        m_sub_reactors.back()->SetRunToCompletion(m_run_to_completion);
+        m_sub_reactors.back()->SetConnAffinity(m_conn_affinity);
     }
 }
 
@@ -134,7 +191,7 @@ bool HttpServer::InitListen()
         return false;
     }
 
-    ret = m_epoll->AddFd(m_listenFd, EPOLLET | EPOLLIN | EPOLLRDHUP); // listenfd ET模式
+    ret = m_main_reactor->AddListen(m_listenFd, [this] { OnListen(); }); // 由主Reactor负责accept
     if (ret == 0) {
         LOG_ERROR("Add listen error!");
         close(m_listenFd);
@@ -161,14 +218,6 @@ void HttpServer::SendError(int fd, const char* info)
     close(fd);
 }
 
-void HttpServer::CloseConn(HttpConnector* client)
-{
-    assert(client);
-    LOG_INFO("Client[%d] quit!", client->GetFd());
-    m_epoll->DelFd(client->GetFd());
-    client->Close();
-}
-
 void HttpServer::OnListen()
 {
     struct sockaddr_in addr { };
@@ -177,72 +226,22 @@ void HttpServer::OnListen()
         int connfd = accept(m_listenFd, (struct sockaddr*)&addr, &len); // accept一个connfd
         if (connfd <= 0) {
             return;
-        } else if (HttpConnector::g_user_count >= MAX_FD) {
+        } else if (HttpConnector::g_user_count >= MAX_FD || connfd >= MAX_FD) { // 连接槽表以fd为下标
             SendError(connfd, "Server busy!");
             LOG_WARN("Clients is full!");
             return;
         }
-        m_users[connfd].Init(connfd, addr);
-        if (m_timeout > 0) {
-            // 将新连接添加到定时器中
-            m_timer->add(connfd, m_timeout, [this, capture0 = &m_users[connfd]] { CloseConn(capture0); });
-        }
-        m_epoll->AddFd(connfd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLONESHOT); // connfd 也是ET模式
         SetFdNonblock(connfd);
-        LOG_INFO("Client[%d] in!", m_users[connfd].GetFd());
+        GetNextReactor()->AddConn(connfd, addr); // 交给选中的Reactor管理
     } while (1); // ET模式
 }
 
-void HttpServer::OnRead(HttpConnector* client)
-{
-    assert(client);
-    ExtentTime(client);
-    /* 模拟Proactor：先由主线程负责读写请求\应答报文，然后由工作线程负责处理请求、填充应答 */
-    int ret = -1;
-    int Errno = 0;
-    ret = client->Read(&Errno); // 写入读缓冲
-    if (ret <= 0 && Errno != EAGAIN) { // 写入失败
-        CloseConn(client);
-        return;
-    }
-    m_threadpool->AddTask([this, client] { OnProcess(client); }); // 写入成功，将任务添加到工作队列，处理请求
-}
-
-void HttpServer::OnProcess(HttpConnector* client)
-{
-    if (client->Process()) { // 处理请求
-        m_epoll->ModFd(client->GetFd(), EPOLLET | EPOLLRDHUP | EPOLLONESHOT | EPOLLOUT); // 处理成功就等待写出应答报文
-    } else {
-        m_epoll->ModFd(client->GetFd(), EPOLLET | EPOLLRDHUP | EPOLLONESHOT | EPOLLIN); // 处理失败就继续等待读取请求报文
-    }
-}
-
-void HttpServer::OnWrite(HttpConnector* client)
-{
-    assert(client);
-    ExtentTime(client);
-    int ret = -1;
-    int Errno = 0;
-    ret = client->Write(&Errno);
-    if (client->ToWriteBytes() == 0) { // 传输完成
-        if (client->IsKeepAlive()) { // 长连接就再次处理请求，此时OnProcess会失败导致继续等待读取请求报文
-            OnProcess(client);
-            return;
-        }
-    } else if (ret < 0) {
-        if (Errno == EAGAIN) { // 写缓冲区满了
-            m_epoll->ModFd(client->GetFd(), EPOLLET | EPOLLRDHUP | EPOLLONESHOT | EPOLLOUT); // 继续等待写出
-            return;
-        }
-    }
-    CloseConn(client);
-}
-
-void HttpServer::ExtentTime(HttpConnector* client)
+Reactor* HttpServer::GetNextReactor()
 {
-    assert(client);
-    // 当连接有新的事件时更新定时器
-    if (m_timeout > 0) {
-        m_timer->adjust(client->GetFd(), m_timeout);
+    if (m_sub_reactors.empty()) {
+        return m_main_reactor.get();
     }
+    Reactor* reactor = m_sub_reactors[m_next_reactor].get();
+    m_next_reactor = (m_next_reactor + 1) % m_sub_reactors.size();
+    return reactor;
 }
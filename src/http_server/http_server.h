@@ -7,14 +7,15 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <thread>
 #include <unistd.h>
-#include <unordered_map>
+#include <vector>
 
 #include "../utils/log.h"
 #include "../utils/threadpool.h"
-#include "../utils/timer.h"
-#include "epoll.h"
+#include "conn_slab.h"
 #include "http_connector.h"
+#include "reactor.h"
 
 class HttpServer {
 public:
@@ -25,6 +26,13 @@ public:
     HttpServer(int port, int timeout, bool linger, int thread_num, bool open_log, int sql_port, const char* sql_user, const char* sql_pwd, const char* dbName, int sqlconnpool_num);
     ~HttpServer()
     {
+        for (auto& reactor : m_sub_reactors) {
+            reactor->Stop();
+        }
+        for (auto& thread : m_reactor_threads) {
+            thread.join();
+        }
+        m_threadpool.reset(); // 剩余任务会访问Reactor与连接，须在它们析构之前执行完
         close(m_listenFd);
         m_is_listen = false;
         free(m_src_dir);
@@ -34,6 +42,10 @@ public:
      * 启动服务器，启动监听服务
      */
     void Start();
+    /**
+     * 线程池的线程数与扩缩计数
+     */
+    ThreadPool::Stats GetPoolStats() const { return m_threadpool->GetStats(); }
 
 private:
     /* 下面的函数用来配置服务器 */
@@ -42,8 +54,10 @@ private:
      * 初始化监听服务器
      */
     bool InitListen();
-    void AddClient(int fd, sockaddr_in addr);
-    void CloseConn(HttpConnector* client);
+    /**
+     * 按配置创建主Reactor以及reactor_num个子Reactor
+     */
+    void InitReactors();
     /**
      * 从配置文件读取属性并设置
      */
@@ -52,17 +66,19 @@ private:
      * 向fd直接发送info
      */
     static void SendError(int fd, const char* info);
-    void ExtentTime(HttpConnector* client);
 
-    /* 下面的函数用来处理http */
+    /**
+     * accept新连接，并轮转分发给各个Reactor
+     */
     void OnListen();
-    void OnRead(HttpConnector* client);
-    void OnWrite(HttpConnector* client);
-    void OnProcess(HttpConnector* client);
+    /**
+     * 轮转选出下一个接管新连接的Reactor，没有子Reactor时即为主Reactor
+     */
+    Reactor* GetNextReactor();
 
     /* 下面的函数用来连接数据库 */
 
-    static const int MAX_FD = 65536;
+    static constexpr int MAX_FD = 65536;
     static int SetFdNonblock(int fd);
 
     /* 下面的参数用来控制listenFd */
@@ -74,10 +90,25 @@ private:
     char* m_src_dir;
     std::atomic<int> g_user_count;
 
-    std::unordered_map<int, HttpConnector> m_users;
-    std::unique_ptr<Epoll> m_epoll;
+    /* 下面的参数可由配置文件设置 */
+    int m_reactor_num; // 子Reactor数量，0代表单Reactor模式：主线程同时负责accept与所有连接的读写
+    Poller::Backend m_backend; // 各Reactor使用的事件后端
+    ThreadPool::Mode m_pool_mode; // 线程池任务队列的组织方式
+    int m_pool_max_threads; // 以下三项为弹性模式的参数，最小线程数即thread_num
+    int m_pool_grow_wait_ms;
+    int m_pool_idle_timeout_ms;
+    std::vector<int> m_reactor_cpus; // 主Reactor与各子Reactor依次绑定的cpu，为空时不绑核
+    std::vector<int> m_worker_cpus; // 各工作线程依次绑定的cpu，为空时不绑核
+    int m_log_cpu; // 日志写线程绑定的cpu，-1为不绑核
+    bool m_run_to_completion; // GET等不会阻塞的请求直接在Reactor线程处理，只把可能阻塞的请求交给线程池
+    bool m_conn_affinity; // 连接绑定到所属Reactor线程，常驻注册读写边沿事件，不再使用EPOLLONESHOT
+
     std::unique_ptr<ThreadPool> m_threadpool;
-    std::unique_ptr<Timer> m_timer;
+    std::unique_ptr<ConnSlab> m_slab; // 以fd为下标的连接槽表，所有Reactor共享
+    std::unique_ptr<Reactor> m_main_reactor; // 主线程的Reactor，持有listenFd
+    std::vector<std::unique_ptr<Reactor>> m_sub_reactors; // 子Reactor，每个运行在自己的线程中
+    std::vector<std::thread> m_reactor_threads;
+    size_t m_next_reactor; // 轮转分发的下标
 };
 
 #endif // _HTTP_SERVER_H_
\ No newline at end of file
@@ -0,0 +1,27 @@
+#include "poller.h"
+#include "../utils/log.h"
+#include "epoll.h"
+#include "uring.h"
+
+std::unique_ptr<Poller> Poller::Create(Backend backend)
+{
+    if (backend == BACKEND_IO_URING) {
+        auto uring = std::make_unique<IoUring>();
+        if (uring->IsValid()) {
+            return uring;
+        }
+        LOG_WARN("io_uring is not available, fall back to epoll");
+    }
+    return std::make_unique<Epoll>();
+}
+
+Poller::Backend Poller::ParseBackend(const std::string& name)
+{
+    if (name == "io_uring") {
+        return BACKEND_IO_URING;
+    }
+    if (name != "epoll") {
+        LOG_WARN("Unknown event backend %s, use epoll", name.c_str());
+    }
+    return BACKEND_EPOLL;
+}
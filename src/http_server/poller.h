@@ -0,0 +1,58 @@
+#ifndef _POLLER_H_
+#define _POLLER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/epoll.h>
+
+/**
+ * 事件后端的抽象接口，Reactor只通过它注册fd、等待事件。各实现统一使用EPOLL*作为事件标志：
+ * EPOLLIN/EPOLLOUT/EPOLLRDHUP/EPOLLHUP/EPOLLERR表示关心或产生的事件，EPOLLONESHOT表示事件触发一次后需要ModFd重新注册
+ */
+class Poller {
+public:
+    enum Backend {
+        BACKEND_EPOLL, // epoll_wait + epoll_ctl
+        BACKEND_IO_URING // io_uring poll，只提供就绪通知，注册与等待批量提交
+    };
+
+    virtual ~Poller() = default;
+
+    /**
+     * 注册fd及其关心的事件，data是fd对应的句柄（如连接对象的指针），产生事件时通过GetEventData原样取回
+     */
+    virtual bool AddFd(int fd, uint32_t events, void* data) = 0;
+    /**
+     * 修改已经注册的fd的关心的事件，data需与注册时一致
+     */
+    virtual bool ModFd(int fd, uint32_t events, void* data) = 0;
+    /**
+     * 删除一个已经注册的fd
+     */
+    virtual bool DelFd(int fd) = 0;
+    /**
+     * 等待注册的fd产生事件，超时时间timeout(ms)，-1代表一直阻塞，返回产生事件的数量
+     */
+    virtual int Wait(int timeout = -1) = 0;
+    /**
+     * 获取第i个事件的来源fd注册时的句柄（应在wait之后调用），事件分发时无需再按fd查表
+     */
+    virtual void* GetEventData(size_t i) const = 0;
+    /**
+     * 获取第i个事件（应在wait之后调用）
+     */
+    virtual uint32_t GetEvents(size_t i) const = 0;
+
+    /**
+     * 创建指定后端，io_uring不可用（内核不支持、被seccomp禁止等）时回退到epoll
+     */
+    static std::unique_ptr<Poller> Create(Backend backend);
+    /**
+     * 将配置文件中的后端名("epoll"/"io_uring")转换为Backend，无法识别时返回BACKEND_EPOLL
+     */
+    static Backend ParseBackend(const std::string& name);
+};
+
+#endif // _POLLER_H_
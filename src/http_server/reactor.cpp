@@ -0,0 +1,296 @@
+#include "reactor.h"
+#include <sys/eventfd.h>
+
+Reactor::Reactor(int timeout, ThreadPool* threadpool, ConnSlab* slab, Poller::Backend backend)
+    : m_timeout(timeout)
+    , m_quit(false)
+    , m_cpu(-1)
+    , m_run_to_completion(false)
+    , m_conn_affinity(false)
+    , m_listenFd(-1)
+    , m_wakeupFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_completions(COMPLETION_CAPACITY)
+    , m_completion_signaled(false)
+    , m_slab(slab)
+    , m_poller(Poller::Create(backend))
+    , m_timer(std::make_unique<TimeWheel>())
+    , m_threadpool(threadpool)
+{
+    assert(m_wakeupFd >= 0 && m_threadpool && m_slab);
+    m_poller->AddFd(m_wakeupFd, EPOLLIN | EPOLLET, &m_wakeupFd); // 以成员地址作为句柄，与连接区分
+}
+
+Reactor::~Reactor()
+{
+    for (auto& item : m_pending_conns) { // 尚未接管的连接直接关闭
+        close(item.first);
+    }
+    close(m_wakeupFd);
+}
+
+void Reactor::Loop()
+{
+    int timeout = -1; // epoll wait timeout == -1 无事件将阻塞
+    m_thread_id.store(std::this_thread::get_id(), std::memory_order_release);
+    if (m_cpu >= 0 && CpuAffinity::PinSelf(m_cpu)) {
+        m_timer = std::make_unique<TimeWheel>(); // Loop之前时间轮为空，绑核后重新创建，使其位于本线程的NUMA节点
+    }
+    CoarseClock::Update();
+    HandleWakeup(); // 接管Loop启动之前交付的连接
+    while (!m_quit) {
+        if (m_timeout > 0) {
+            timeout = m_timer->GetNextTick(); // 获取下一个事件剩余时间
+        }
+        int eventCnt = m_poller->Wait(timeout);
+        CoarseClock::Update(); // 每轮只读一次时钟，本轮的定时器、日志都使用缓存的时间
+        for (int i = 0; i < eventCnt; i++) { // 根据epoll上的事件，转发至对应方法
+            void* data = m_poller->GetEventData(i); // 注册时的句柄，连接直接取出，无需查表
+            uint32_t events = m_poller->GetEvents(i);
+            if (i + 1 < eventCnt) {
+                __builtin_prefetch(m_poller->GetEventData(i + 1)); // 处理本事件时预取下一个连接的状态
+            }
+            if (data == &m_listenFd) { // 新客户端连接
+                m_listen_cb();
+            } else if (data == &m_wakeupFd) { // 其他线程交付了新连接或处理完了请求
+                HandleWakeup();
+            } else if (m_conn_affinity) { // 连接常驻注册，读写事件可能同时到达，处理期间的挂断也会通知
+                OnEvent(static_cast<HttpConnector*>(data), events);
+            } else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) { // 连接异常
+                CloseConn(static_cast<HttpConnector*>(data));
+            } else if (events & EPOLLIN) { // 客户端发送数据
+                OnRead(static_cast<HttpConnector*>(data));
+            } else if (events & EPOLLOUT) { // 服务器发送数据
+                OnWrite(static_cast<HttpConnector*>(data));
+            } else {
+                LOG_ERROR("Unexpected event");
+            }
+        }
+    }
+}
+
+void Reactor::Stop()
+{
+    m_quit = true;
+    Wakeup(); // 唤醒阻塞在epoll_wait上的循环，使其检查m_quit
+}
+
+bool Reactor::AddListen(int listenFd, const std::function<void()>& cb)
+{
+    assert(listenFd > 0 && cb);
+    m_listenFd = listenFd;
+    m_listen_cb = cb;
+    return m_poller->AddFd(m_listenFd, EPOLLET | EPOLLIN | EPOLLRDHUP, &m_listenFd); // listenfd ET模式
+}
+
+void Reactor::AddConn(int fd, const sockaddr_in& addr)
+{
+    if (IsInLoopThread()) { // 单Reactor模式下accept与处理连接在同一线程，直接接管
+        OnNewConn(fd, addr);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> locker(m_pending_mutex);
+        m_pending_conns.emplace_back(fd, addr);
+    }
+    Wakeup();
+}
+
+void Reactor::Wakeup()
+{
+    uint64_t one = 1;
+    if (write(m_wakeupFd, &one, sizeof(one)) != sizeof(one)) {
+        LOG_WARN("Reactor wakeup error!");
+    }
+}
+
+void Reactor::HandleWakeup()
+{
+    uint64_t cnt = 0;
+    while (read(m_wakeupFd, &cnt, sizeof(cnt)) > 0) { } // ET模式，读空eventfd计数
+    std::vector<std::pair<int, sockaddr_in>> conns;
+    {
+        std::lock_guard<std::mutex> locker(m_pending_mutex);
+        conns.swap(m_pending_conns); // 交换出来，处理时不持有锁
+    }
+    for (auto& item : conns) {
+        OnNewConn(item.first, item.second);
+    }
+    HandleCompletions();
+}
+
+void Reactor::OnNewConn(int fd, const sockaddr_in& addr)
+{
+    HttpConnector* client = m_slab->Get(fd);
+    assert(!client->IsBusy()); // 工作线程持有的连接不会被关闭，其fd也就不会被复用
+    client->Init(fd, addr);
+    if (m_timeout > 0) {
+        // 将新连接添加到定时器中，连接先被其他原因关闭时回调因代数不一致而失效
+        m_timer->add(fd, m_timeout, [this, client, gen = m_slab->GetGen(fd)] {
+            if (m_slab->IsCurrent(client->GetFd(), gen)) {
+                CloseConn(client);
+            }
+        });
+    }
+    if (m_conn_affinity) { // 连接只由本线程处理，一次注册读写事件，此后不再修改
+        m_poller->AddFd(fd, EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP, client);
+    } else {
+        m_poller->AddFd(fd, EPOLLIN | EPOLLET | EPOLLRDHUP | EPOLLONESHOT, client); // connfd 也是ET模式
+    }
+    LOG_INFO("Client[%d] in!", client->GetFd());
+}
+
+void Reactor::Complete(HttpConnector* client, uint32_t gen, bool ret)
+{
+    Completion item { client, gen, ret };
+    if (!m_completions.TryPush(item)) { // 所属线程积压了过多完成(几乎不会发生)，放入溢出队列，连接状态仍只由所属线程修改
+        {
+            std::lock_guard<std::mutex> locker(m_pending_mutex);
+            m_overflow_completions.push_back(item);
+        }
+        Wakeup();
+        return;
+    }
+    if (!m_completion_signaled.exchange(true)) { // 标记已被置位说明所属线程尚未取走本批，它会一并处理
+        Wakeup();
+    }
+}
+
+void Reactor::HandleCompletions()
+{
+    m_completion_signaled.exchange(false); // 先清除标记再取，此后压入的连接会再次唤醒
+    Completion item;
+    while (m_completions.TryPop(item)) {
+        OnCompletion(item);
+    }
+    std::vector<Completion> overflow;
+    {
+        std::lock_guard<std::mutex> locker(m_pending_mutex);
+        overflow.swap(m_overflow_completions);
+    }
+    for (auto& item : overflow) {
+        OnCompletion(item);
+    }
+}
+
+void Reactor::OnCompletion(const Completion& item)
+{
+    HttpConnector* client = item.client;
+    if (!m_slab->IsCurrent(client->GetFd(), item.gen)) { // 防御性检查：busy的连接不会被关闭，代数在处理期间不变
+        return;
+    }
+    client->SetBusy(false);
+    if (client->IsClosePending()) { // 处理期间对端挂断或超时
+        CloseConn(client);
+    } else if (item.ret) {
+        OnWrite(client); // 乐观写，写完后长连接会试探性地读取下一个请求
+    } else {
+        OnRead(client); // 没有完整的请求，连接绑定时处理期间到达的数据不会再通知，需主动读取
+    }
+}
+
+void Reactor::CloseConn(HttpConnector* client)
+{
+    assert(client);
+    if (client->IsBusy()) { // 工作线程仍在使用连接，关闭(代数递增、fd可被复用、槽被重新Init)推迟到处理完成后
+        client->SetClosePending();
+        return;
+    }
+    LOG_INFO("Client[%d] quit!", client->GetFd());
+    m_poller->DelFd(client->GetFd());
+    m_slab->Retire(client->GetFd()); // 先使排队中的任务、定时器失效，再关闭fd，fd关闭后随时可能被复用
+    client->Close();
+}
+
+void Reactor::OnRead(HttpConnector* client)
+{
+    assert(client);
+    ExtentTime(client);
+    /* 模拟Proactor：先由主线程负责读写请求\应答报文，然后由工作线程负责处理请求、填充应答 */
+    int ret = -1;
+    int Errno = 0;
+    ret = client->Read(&Errno); // 写入读缓冲
+    if (ret <= 0 && Errno != EAGAIN) { // 写入失败
+        CloseConn(client);
+        return;
+    }
+    if (!client->HasRequest()) { // 还没有完整的请求（长连接写完后的试探性读取，或请求被拆成了多段），继续等待读取请求报文
+        Rearm(client, EPOLLIN);
+        return;
+    }
+    if ((m_run_to_completion || m_conn_affinity) && !client->MayBlock()) { // 处理的开销比交给线程池还小，直接处理
+        OnProcess(client, m_slab->GetGen(client->GetFd()));
+        return;
+    }
+    client->SetBusy(true); // 交给线程池期间连接归工作线程使用，本线程忽略其事件，超时与挂断推迟到处理完成后关闭
+    m_threadpool->AddTask([this, client, gen = m_slab->GetGen(client->GetFd())] { OnProcess(client, gen); }); // 写入成功，将任务添加到工作队列，处理请求
+}
+
+void Reactor::OnProcess(HttpConnector* client, uint32_t gen)
+{
+    if (!m_slab->IsCurrent(client->GetFd(), gen)) { // 防御性检查：排队期间连接为busy，不会被关闭
+        return;
+    }
+    bool ret = client->Process(); // 处理请求
+    if (!IsInLoopThread()) { // 交还给所属线程写出，工作线程不修改epoll注册；处理期间连接处于busy状态，所属线程的定时器只标记关闭，不会关闭、复用连接
+        Complete(client, gen, ret);
+    } else if (ret) { // 乐观写：发送缓冲区通常可写，直接写出，写不完(EAGAIN)时OnWrite再注册EPOLLOUT
+        OnWrite(client);
+    } else {
+        Rearm(client, EPOLLIN); // 处理失败就继续等待读取请求报文
+    }
+}
+
+void Reactor::OnEvent(HttpConnector* client, uint32_t events)
+{
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) { // 连接异常，正在线程池中处理时由CloseConn推迟到处理完成后
+        CloseConn(client);
+        return;
+    }
+    if (client->IsBusy()) { // 正在线程池中处理，处理完后由HandleCompletions继续写出或读取
+        return;
+    }
+    if (client->ToWriteBytes() > 0) { // 应答还没写完，写完后OnWrite会读取下一个请求
+        if (events & EPOLLOUT) {
+            OnWrite(client);
+        }
+    } else if (events & EPOLLIN) {
+        OnRead(client);
+    }
+}
+
+void Reactor::Rearm(HttpConnector* client, uint32_t events)
+{
+    if (!m_conn_affinity) { // 连接常驻注册时边沿事件会自动到达，不需要重新注册
+        m_poller->ModFd(client->GetFd(), EPOLLET | EPOLLRDHUP | EPOLLONESHOT | events, client);
+    }
+}
+
+void Reactor::OnWrite(HttpConnector* client)
+{
+    assert(client);
+    ExtentTime(client);
+    int ret = -1;
+    int Errno = 0;
+    ret = client->Write(&Errno);
+    if (client->ToWriteBytes() == 0) { // 传输完成
+        if (client->IsKeepAlive()) { // 长连接就试探性地读取下一个请求，没有数据时再注册EPOLLIN
+            OnRead(client);
+            return;
+        }
+    } else if (ret < 0) {
+        if (Errno == EAGAIN) { // 写缓冲区满了
+            Rearm(client, EPOLLOUT); // 继续等待写出
+            return;
+        }
+    }
+    CloseConn(client);
+}
+
+void Reactor::ExtentTime(HttpConnector* client)
+{
+    assert(client);
+    // 当连接有新的事件时更新定时器
+    if (m_timeout > 0) {
+        m_timer->adjust(client->GetFd(), m_timeout);
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef _REACTOR_H_
+#define _REACTOR_H_
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../utils/affinity.h"
+#include "../utils/coarse_clock.h"
+#include "../utils/log.h"
+#include "../utils/mpmc_ring.h"
+#include "../utils/threadpool.h"
+#include "../utils/time_wheel.h"
+#include "conn_slab.h"
+#include "http_connector.h"
+#include "poller.h"
+
+/**
+ * 反应堆(one loop per thread)：每个Reactor独占一个事件后端(Poller)和一个时间轮(TimeWheel)，在自己的线程中负责其名下连接的读写与超时，
+ * 连接本身存放在所有Reactor共享的ConnSlab中（fd在进程内唯一，每个Reactor只访问自己名下fd的槽），
+ * 请求的处理仍交给所有Reactor共享的线程池，处理完的连接经由Reactor的完成队列交还所属线程，epoll的注册与读写只在所属线程中进行。
+ * 单Reactor模式下由主线程的Reactor兼任accept；多Reactor模式下主线程只负责accept，新连接按轮转分发给各个子Reactor。
+ */
+class Reactor {
+public:
+    /**
+     * timeout：连接的超时时间(ms)，threadpool：处理请求的线程池，slab：连接槽表，backend：使用的事件后端
+     */
+    Reactor(int timeout, ThreadPool* threadpool, ConnSlab* slab, Poller::Backend backend = Poller::BACKEND_EPOLL);
+    ~Reactor();
+
+    /**
+     * 启动事件循环，阻塞直到Stop被调用，调用Loop的线程即为本Reactor的所属线程
+     */
+    void Loop();
+    /**
+     * 停止事件循环，可以在任意线程调用
+     */
+    void Stop();
+    /**
+     * 注册监听fd，其上产生事件时调用cb
+     */
+    bool AddListen(int listenFd, const std::function<void()>& cb);
+    /**
+     * 将一个已accept的连接交给本Reactor管理，可以在任意线程调用：非所属线程调用时先入队，再通过eventfd唤醒所属线程处理
+     */
+    void AddConn(int fd, const sockaddr_in& addr);
+
+    /**
+     * 当前线程是否为所属线程，可以在任意线程调用：Loop启动前总是返回false，连接交付走入队唤醒的路径
+     */
+    bool IsInLoopThread() const { return m_thread_id.load(std::memory_order_acquire) == std::this_thread::get_id(); }
+    /**
+     * 设置所属线程绑定的cpu，需在Loop之前调用，cpu<0时不绑核
+     */
+    void SetCpu(int cpu) { m_cpu = cpu; }
+    /**
+     * 设置是否在Reactor线程中直接处理不会阻塞的请求（静态文件、错误应答），只把可能阻塞的请求交给线程池
+     */
+    void SetRunToCompletion(bool on) { m_run_to_completion = on; }
+    /**
+     * 设置是否启用连接与线程绑定：连接一次注册读写边沿事件后不再修改(不使用EPOLLONESHOT)，不会阻塞的请求直接在本线程处理，
+     * 可能阻塞的请求交给线程池期间本线程忽略该连接的事件，需在Loop之前调用
+     */
+    void SetConnAffinity(bool on) { m_conn_affinity = on; }
+
+private:
+    /* 工作线程处理完的连接 */
+    struct Completion {
+        HttpConnector* client;
+        uint32_t gen; // 任务创建时连接的代数
+        bool ret; // Process的返回值，true为应答已就绪
+    };
+
+    static const size_t COMPLETION_CAPACITY = 4096; // 完成队列的容量，队列满时放入加锁的溢出队列
+
+    /* 下面的函数用来处理跨线程交付的新连接与处理完的连接 */
+
+    void Wakeup();
+    void HandleWakeup();
+    void OnNewConn(int fd, const sockaddr_in& addr);
+    /**
+     * 在工作线程中调用，把处理完的连接压入完成队列，队列由空变为非空后第一次压入时才写eventfd，同一批完成只唤醒一次
+     */
+    void Complete(HttpConnector* client, uint32_t gen, bool ret);
+    /**
+     * 在所属线程中取出完成队列中的全部连接，写出应答或继续读取请求
+     */
+    void HandleCompletions();
+    void OnCompletion(const Completion& item);
+
+    /* 下面的函数用来处理http */
+
+    void CloseConn(HttpConnector* client);
+    void ExtentTime(HttpConnector* client);
+    void OnRead(HttpConnector* client);
+    void OnWrite(HttpConnector* client);
+    /**
+     * gen为任务创建时连接的代数，不一致说明连接已被关闭，直接丢弃
+     */
+    void OnProcess(HttpConnector* client, uint32_t gen);
+    /**
+     * 连接与线程绑定时，按连接状态分发同时到达的读写、挂断事件，正在线程池中处理的连接推迟到处理完成后
+     */
+    void OnEvent(HttpConnector* client, uint32_t events);
+    /**
+     * 以EPOLLONESHOT重新注册events，连接与线程绑定时不需要重新注册
+     */
+    void Rearm(HttpConnector* client, uint32_t events);
+
+    int m_timeout;
+    std::atomic<bool> m_quit; // 是否退出事件循环
+    std::atomic<std::thread::id> m_thread_id; // 所属线程，Loop启动前为空；主线程与工作线程也会读取
+    int m_cpu; // 所属线程绑定的cpu，-1为不绑核
+    bool m_run_to_completion; // 不会阻塞的请求是否直接在Reactor线程处理
+    bool m_conn_affinity; // 连接是否常驻注册读写事件，只由本线程处理
+
+    int m_listenFd; // 仅兼任accept的Reactor持有
+    std::function<void()> m_listen_cb;
+
+    int m_wakeupFd; // 用于跨线程唤醒的eventfd
+    std::mutex m_pending_mutex;
+    std::vector<std::pair<int, sockaddr_in>> m_pending_conns; // 等待所属线程接管的新连接
+    MpmcRing<Completion> m_completions; // 工作线程处理完、等待所属线程写出的连接
+    std::vector<Completion> m_overflow_completions; // 完成队列满时的完成，由m_pending_mutex保护
+    std::atomic<bool> m_completion_signaled; // 本批完成是否已写过eventfd
+
+    ConnSlab* m_slab; // 所有Reactor共享的连接槽表
+    std::unique_ptr<Poller> m_poller;
+    std::unique_ptr<TimeWheel> m_timer;
+    ThreadPool* m_threadpool;
+};
+
+#endif // _REACTOR_H_
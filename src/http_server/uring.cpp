@@ -0,0 +1,281 @@
+#include "uring.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const uint64_t TIMEOUT_USER_DATA = UINT64_MAX; // Wait超时SQE的user_data
+static const uint64_t REMOVE_USER_DATA = UINT64_MAX - 1; // 取消poll的SQE的user_data
+static const uint32_t POLL_MASK = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLERR | EPOLLHUP; // poll能识别的事件位
+
+static int SysSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int SysEnter(int ringfd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringfd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+IoUring::IoUring(unsigned entries, int maxEvent)
+    : m_ringfd(-1)
+    , m_sq_entries(0)
+    , m_cq_entries(0)
+    , m_sq_ptr(MAP_FAILED)
+    , m_sq_size(0)
+    , m_cq_ptr(MAP_FAILED)
+    , m_cq_size(0)
+    , m_sqes(static_cast<io_uring_sqe*>(MAP_FAILED))
+    , m_sqes_size(0)
+    , m_sq_tail(0)
+    , m_ts({ 0, 0 })
+    , m_max_event(maxEvent)
+{
+    assert(maxEvent > 0);
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ringfd = SysSetup(entries, &params);
+    if (ringfd < 0) {
+        return;
+    }
+
+    /* 映射SQ环、CQ环以及SQE数组，新内核(IORING_FEAT_SINGLE_MMAP)中SQ环与CQ环共用一次映射 */
+    m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+    }
+    m_sq_ptr = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+        close(ringfd);
+        return;
+    }
+    m_cq_ptr = single_mmap ? m_sq_ptr : mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+    m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES));
+    if (m_cq_ptr == MAP_FAILED || m_sqes == MAP_FAILED) {
+        close(ringfd);
+        return;
+    }
+
+    char* sq = static_cast<char*>(m_sq_ptr);
+    char* cq = static_cast<char*>(m_cq_ptr);
+    m_sq_khead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sq_ktail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sq_kmask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sq_karray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_cq_khead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cq_ktail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cq_kmask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    m_sq_tail = *m_sq_ktail;
+    m_sq_entries = params.sq_entries;
+    m_cq_entries = params.cq_entries;
+    m_events.reserve(maxEvent);
+    m_ringfd = ringfd;
+}
+
+IoUring::~IoUring()
+{
+    if (m_sqes != MAP_FAILED) {
+        munmap(m_sqes, m_sqes_size);
+    }
+    if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) {
+        munmap(m_cq_ptr, m_cq_size);
+    }
+    if (m_sq_ptr != MAP_FAILED) {
+        munmap(m_sq_ptr, m_sq_size);
+    }
+    if (m_ringfd >= 0) {
+        close(m_ringfd);
+    }
+}
+
+io_uring_sqe* IoUring::GetSqe()
+{
+    while (m_sq_tail - __atomic_load_n(m_sq_khead, __ATOMIC_ACQUIRE) >= m_sq_entries) { // SQ满了，先提交
+        if (SysEnter(m_ringfd, m_sq_entries, 0, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return nullptr;
+        }
+    }
+    unsigned index = m_sq_tail & *m_sq_kmask;
+    io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sq_karray[index] = index;
+    return sqe;
+}
+
+void IoUring::PublishSqe()
+{
+    m_sq_tail++;
+    __atomic_store_n(m_sq_ktail, m_sq_tail, __ATOMIC_RELEASE); // 内核读取tail之前，SQE的内容必须可见
+}
+
+void IoUring::PreparePoll(int fd, uint32_t events)
+{
+    io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & POLL_MASK;
+    if (!(events & EPOLLONESHOT)) {
+        sqe->len = IORING_POLL_ADD_MULTI; // 非oneshot：一次注册持续产生事件
+    }
+    sqe->user_data = PackUserData(fd, m_gen[fd]);
+    PublishSqe();
+    m_armed[fd] = true;
+}
+
+void IoUring::PrepareRemove(int fd)
+{
+    io_uring_sqe* sqe = GetSqe();
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = PackUserData(fd, m_gen[fd]);
+    sqe->user_data = REMOVE_USER_DATA;
+    PublishSqe();
+    m_armed[fd] = false;
+}
+
+bool IoUring::AddFd(int fd, uint32_t events, void* data)
+{
+    return ModFd(fd, events, data);
+}
+
+bool IoUring::ModFd(int fd, uint32_t events, void* data)
+{
+    if (fd < 0)
+        return false;
+    std::lock_guard<std::mutex> locker(m_sq_mutex);
+    if (static_cast<size_t>(fd) >= m_gen.size()) {
+        m_gen.resize(fd + 1, 0);
+        m_interest.resize(fd + 1, 0);
+        m_armed.resize(fd + 1, false);
+        m_data.resize(fd + 1, nullptr);
+    }
+    if (m_armed[fd]) { // 仍在内核中的poll先取消，其之后的完成事件因代数不同被丢弃
+        PrepareRemove(fd);
+        m_gen[fd]++;
+    }
+    m_interest[fd] = events;
+    m_data[fd] = data;
+    PreparePoll(fd, events);
+    if (std::this_thread::get_id() != m_wait_thread) { // Reactor可能正阻塞在等待上，立即提交
+        SysEnter(m_ringfd, m_sq_tail - __atomic_load_n(m_sq_khead, __ATOMIC_ACQUIRE), 0, 0);
+    }
+    return true;
+}
+
+bool IoUring::DelFd(int fd)
+{
+    if (fd < 0)
+        return false;
+    std::lock_guard<std::mutex> locker(m_sq_mutex);
+    if (static_cast<size_t>(fd) >= m_gen.size()) {
+        return false;
+    }
+    if (m_armed[fd]) {
+        PrepareRemove(fd);
+    }
+    m_gen[fd]++;
+    m_interest[fd] = 0;
+    return true;
+}
+
+int IoUring::Enter(unsigned min_complete, unsigned flags)
+{
+    unsigned to_submit = 0;
+    {
+        std::lock_guard<std::mutex> locker(m_sq_mutex);
+        to_submit = m_sq_tail - __atomic_load_n(m_sq_khead, __ATOMIC_ACQUIRE);
+    }
+    if (to_submit == 0 && min_complete == 0) {
+        return 0;
+    }
+    return SysEnter(m_ringfd, to_submit, min_complete, flags);
+}
+
+int IoUring::Wait(int timeout)
+{
+    {
+        std::lock_guard<std::mutex> locker(m_sq_mutex);
+        m_wait_thread = std::this_thread::get_id();
+    }
+    int cnt = Reap();
+    if (cnt > 0 || timeout == 0) { // 已有完成事件，只提交不等待
+        Enter(0, 0);
+        return cnt > 0 ? cnt : Reap();
+    }
+    if (timeout > 0) { // 超时也以SQE的形式提交，off = 1代表有其他完成事件时即结束
+        std::lock_guard<std::mutex> locker(m_sq_mutex);
+        io_uring_sqe* sqe = GetSqe();
+        if (sqe) {
+            m_ts.tv_sec = timeout / 1000;
+            m_ts.tv_nsec = (timeout % 1000) * 1000000LL;
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->fd = -1;
+            sqe->addr = reinterpret_cast<uint64_t>(&m_ts);
+            sqe->len = 1;
+            sqe->off = 1;
+            sqe->user_data = TIMEOUT_USER_DATA;
+            PublishSqe();
+        }
+    }
+    if (Enter(1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != ETIME) { // 一次系统调用完成提交与等待
+        return -1;
+    }
+    return Reap();
+}
+
+int IoUring::Reap()
+{
+    std::lock_guard<std::mutex> locker(m_sq_mutex);
+    m_events.clear();
+    unsigned head = *m_cq_khead;
+    unsigned tail = __atomic_load_n(m_cq_ktail, __ATOMIC_ACQUIRE);
+    while (head != tail && m_events.size() < static_cast<size_t>(m_max_event)) {
+        const io_uring_cqe& cqe = m_cqes[head & *m_cq_kmask];
+        head++;
+        if (cqe.user_data == TIMEOUT_USER_DATA || cqe.user_data == REMOVE_USER_DATA) {
+            continue;
+        }
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t gen = static_cast<uint32_t>(cqe.user_data >> 32);
+        if (static_cast<size_t>(fd) >= m_gen.size() || m_gen[fd] != gen) { // 已删除或重新注册过的fd的过期事件
+            continue;
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) { // poll已结束，不再在内核中
+            m_armed[fd] = false;
+            if (m_interest[fd] && !(m_interest[fd] & EPOLLONESHOT) && cqe.res != -ECANCELED) {
+                PreparePoll(fd, m_interest[fd]); // multishot被内核结束（如CQ溢出），重新注册以保持语义
+            }
+        }
+        if (cqe.res == -ECANCELED) {
+            continue;
+        }
+        m_events.push_back({ m_data[fd], cqe.res < 0 ? static_cast<uint32_t>(EPOLLERR) : static_cast<uint32_t>(cqe.res) });
+    }
+    __atomic_store_n(m_cq_khead, head, __ATOMIC_RELEASE);
+    return static_cast<int>(m_events.size());
+}
+
+void* IoUring::GetEventData(size_t i) const
+{
+    assert(i < m_events.size());
+    return m_events[i].data;
+}
+
+uint32_t IoUring::GetEvents(size_t i) const
+{
+    assert(i < m_events.size());
+    return m_events[i].events;
+}
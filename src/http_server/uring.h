@@ -0,0 +1,105 @@
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <cassert>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "poller.h"
+
+/**
+ * io_uring就绪通知后端：只以IORING_OP_POLL_ADD/POLL_REMOVE代替epoll_ctl注册事件，accept、读、写仍由连接各自发起系统调用。
+ * Reactor线程内的注册/修改/删除只是填写SQE，在下一次Wait时与等待一起通过一次io_uring_enter批量提交，
+ * 因此节省的只是oneshot模式下每个请求重新注册时的一次epoll_ctl(长连接每个请求约5次系统调用降为4次)，
+ * conn_affinity模式不重新注册，与epoll没有差别，见bench/poller_bench.cpp。
+ * EPOLLONESHOT对应单次poll，否则使用multishot poll保持注册。
+ * 其他线程（如线程池中的工作线程）调用ModFd时，由于Reactor可能正阻塞在等待上，会立即提交本次修改。
+ */
+class IoUring : public Poller {
+public:
+    explicit IoUring(unsigned entries = 4096, int maxEvent = 1024);
+    ~IoUring() override;
+
+    /**
+     * 构造是否成功，内核不支持io_uring时为false
+     */
+    bool IsValid() const { return m_ringfd >= 0; }
+
+    bool AddFd(int fd, uint32_t events, void* data) override;
+    bool ModFd(int fd, uint32_t events, void* data) override;
+    bool DelFd(int fd) override;
+    int Wait(int timeout = -1) override;
+    void* GetEventData(size_t i) const override;
+    uint32_t GetEvents(size_t i) const override;
+
+private:
+    struct Event {
+        void* data;
+        uint32_t events;
+    };
+
+    /**
+     * 取一个空闲SQE，SQ满时先提交已有的SQE，调用前需持有m_sq_mutex
+     */
+    io_uring_sqe* GetSqe();
+    /**
+     * 将SQE发布给内核（更新SQ tail），调用前需持有m_sq_mutex
+     */
+    void PublishSqe();
+    /**
+     * 为fd填写一个poll SQE，调用前需持有m_sq_mutex
+     */
+    void PreparePoll(int fd, uint32_t events);
+    /**
+     * 为fd当前的poll填写一个取消SQE，调用前需持有m_sq_mutex
+     */
+    void PrepareRemove(int fd);
+    /**
+     * 提交已发布但内核尚未消费的SQE，min_complete > 0 时同时等待完成事件
+     */
+    int Enter(unsigned min_complete, unsigned flags);
+    /**
+     * 收割CQ中的完成事件，转换为m_events
+     */
+    int Reap();
+
+    static uint64_t PackUserData(int fd, uint32_t gen) { return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd); }
+
+    int m_ringfd;
+    unsigned m_sq_entries;
+    unsigned m_cq_entries;
+
+    /* 与内核共享的SQ、CQ环，以及SQE数组 */
+    void* m_sq_ptr;
+    size_t m_sq_size;
+    void* m_cq_ptr;
+    size_t m_cq_size;
+    io_uring_sqe* m_sqes;
+    size_t m_sqes_size;
+    unsigned* m_sq_khead;
+    unsigned* m_sq_ktail;
+    unsigned* m_sq_kmask;
+    unsigned* m_sq_karray;
+    unsigned* m_cq_khead;
+    unsigned* m_cq_ktail;
+    unsigned* m_cq_kmask;
+    io_uring_cqe* m_cqes;
+    unsigned m_sq_tail; // 本地SQ tail，PublishSqe时写回内核
+
+    std::mutex m_sq_mutex; // SQ以及下面fd状态的锁，工作线程也会调用ModFd
+    std::vector<uint32_t> m_gen; // fd的注册代数，每次重新注册或删除时递增，用于丢弃过期的完成事件
+    std::vector<uint32_t> m_interest; // fd当前关心的事件，0代表未注册
+    std::vector<bool> m_armed; // fd的poll是否仍在内核中
+    std::vector<void*> m_data; // fd注册时的句柄，user_data中已存放fd与代数，句柄另外按fd保存
+
+    std::thread::id m_wait_thread; // 调用Wait的线程，其他线程的修改需要立即提交
+    struct __kernel_timespec m_ts; // Wait超时使用的时间
+    std::vector<Event> m_events; // 本次Wait收割到的事件
+    int m_max_event;
+};
+
+#endif // _URING_H_
@@ -1,4 +1,6 @@
+#include "http_server/http_connector.h"
 #include "http_server/http_server.h"
+#include <unistd.h>
 
 /*
  * WebServer服务的启动入口函数，应该被编译名为main的可执行文件
@@ -7,5 +9,34 @@
 int main(int argc, char* argv[])
 {
     HttpServer server(8080, 60000, true, 8, true, 3306, "root", "111111", "webserver", 8);
+    /* 流式应答的示例：/status不对应文件，应答体在请求时生成，以分块编码写出 */
+    HttpConnector::AddStreamRoute("/status", [&server](const HttpRequest&) {
+        return [&server](Buffer& out) {
+            ThreadPool::Stats stats = server.GetPoolStats();
+            out.Append("users: " + std::to_string(HttpConnector::g_user_count.load()) + "\n");
+            out.Append("threads: " + std::to_string(stats.threads) + ", peak: " + std::to_string(stats.peak)
+                + ", grows: " + std::to_string(stats.grows) + ", retires: " + std::to_string(stats.retires) + "\n");
+            return false;
+        };
+    });
+    /* 接收请求体的示例：/upload接收不超过body_max_size的请求体，较大时从临时文件中读取，应答其长度与逐字节的和 */
+    HttpConnector::AddBodyRoute("/upload", [](const HttpRequest& request) {
+        uint64_t sum = 0;
+        for (unsigned char ch : request.GetBody()) {
+            sum += ch;
+        }
+        char buf[65536];
+        ssize_t len = 0;
+        for (off_t off = 0; request.GetBodyFd() >= 0 && (len = pread(request.GetBodyFd(), buf, sizeof(buf), off)) > 0; off += len) {
+            for (ssize_t i = 0; i < len; i++) {
+                sum += static_cast<unsigned char>(buf[i]);
+            }
+        }
+        std::string text = "received: " + std::to_string(request.GetBodyLength()) + ", sum: " + std::to_string(sum) + "\n";
+        return [text](Buffer& out) {
+            out.Append(text);
+            return false;
+        };
+    });
     server.Start();
 }
@@ -0,0 +1,52 @@
+#include "affinity.h"
+#include "log.h"
+#include <sched.h>
+
+/* 进程启动时(各线程绑核之前)允许运行的cpu集合 */
+static cpu_set_t ReadProcessMask()
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return set;
+}
+static const cpu_set_t g_process_mask = ReadProcessMask();
+
+bool CpuAffinity::PinSelf(int cpu)
+{
+    return Pin(pthread_self(), cpu);
+}
+
+bool CpuAffinity::Pin(pthread_t thread, int cpu)
+{
+    if (cpu < 0) {
+        return true;
+    }
+    if (cpu >= CPU_SETSIZE) {
+        LOG_WARN("Cpu %d out of range, thread not pinned", cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (ret != 0) { // cpu不存在或不在进程允许的范围内
+        LOG_WARN("Pin thread to cpu %d failed, errno: %d", cpu, ret);
+        return false;
+    }
+    return true;
+}
+
+bool CpuAffinity::ResetSelf()
+{
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(g_process_mask), &g_process_mask);
+    if (ret != 0) {
+        LOG_WARN("Reset thread affinity failed, errno: %d", ret);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+#include <pthread.h>
+#include <vector>
+
+/**
+ * 线程绑核：把线程固定在指定的CPU上运行。
+ * 没有引入libnuma，NUMA节点上的内存分配依赖内核默认的first-touch策略：线程绑核之后再分配并初次写入的内存会落在该CPU所在的节点上，
+ * 因此各线程独占的数据结构应在绑核之后由该线程自己创建。
+ */
+class CpuAffinity {
+public:
+    /**
+     * 把当前线程绑定到cpu上，cpu<0时不做任何事
+     */
+    static bool PinSelf(int cpu);
+    /**
+     * 把指定线程绑定到cpu上，cpu<0时不做任何事
+     */
+    static bool Pin(pthread_t thread, int cpu);
+    /**
+     * 把当前线程恢复为进程启动时允许的全部cpu，用于从已绑核的线程中创建、不指定cpu的线程，
+     * 否则新线程会继承创建者的绑核
+     */
+    static bool ResetSelf();
+    /**
+     * 从列表中取第index个线程使用的cpu，列表较短时循环使用，列表为空时返回-1（不绑核）
+     */
+    static int Pick(const std::vector<int>& cpus, size_t index)
+    {
+        return cpus.empty() ? -1 : cpus[index % cpus.size()];
+    }
+};
+
+#endif // _AFFINITY_H_
@@ -0,0 +1,36 @@
+#include "coarse_clock.h"
+
+thread_local bool CoarseClock::t_cached = false;
+thread_local int64_t CoarseClock::t_now_ms = 0;
+thread_local struct timespec CoarseClock::t_wall = { 0, 0 };
+
+int64_t CoarseClock::ReadMonotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+struct timespec CoarseClock::ReadWallTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    return ts;
+}
+
+void CoarseClock::Update()
+{
+    t_now_ms = ReadMonotonicMs();
+    t_wall = ReadWallTime();
+    t_cached = true;
+}
+
+int64_t CoarseClock::NowMs()
+{
+    return t_cached ? t_now_ms : ReadMonotonicMs();
+}
+
+struct timespec CoarseClock::WallTime()
+{
+    return t_cached ? t_wall : ReadWallTime();
+}
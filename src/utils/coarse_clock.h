@@ -0,0 +1,37 @@
+#ifndef _COARSE_CLOCK_H_
+#define _COARSE_CLOCK_H_
+
+#include <cstdint>
+#include <ctime>
+
+/**
+ * 事件循环使用的粗粒度时钟：事件循环线程每次Wait返回后调用一次Update，把CLOCK_MONOTONIC_COARSE与CLOCK_REALTIME_COARSE
+ * (由vDSO读取，不陷入内核)缓存在线程局部变量中，此后本轮循环内的定时器、日志时间戳都直接读取缓存值。
+ * 从未调用过Update的线程（线程池的工作线程等）每次读取时直接读粗粒度时钟。
+ * 粗粒度时钟的精度为一个时钟节拍(通常1~4ms)，对连接超时、日志时间戳足够。
+ */
+class CoarseClock {
+public:
+    /**
+     * 刷新当前线程缓存的时间，调用过之后当前线程的读取都使用缓存值
+     */
+    static void Update();
+    /**
+     * 单调时间(ms)
+     */
+    static int64_t NowMs();
+    /**
+     * 墙上时间，用于日志时间戳
+     */
+    static struct timespec WallTime();
+
+private:
+    static int64_t ReadMonotonicMs();
+    static struct timespec ReadWallTime();
+
+    static thread_local bool t_cached; // 当前线程是否由事件循环刷新
+    static thread_local int64_t t_now_ms;
+    static thread_local struct timespec t_wall;
+};
+
+#endif // _COARSE_CLOCK_H_
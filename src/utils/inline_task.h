@@ -0,0 +1,103 @@
+#ifndef _INLINE_TASK_H_
+#define _INLINE_TASK_H_
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * 定长的可调用对象：把lambda表达式等可调用对象直接存放在内部缓冲区中，不会像std::function那样在捕获超出其小对象缓冲区时申请堆内存。
+ * 捕获超过CAPACITY字节时编译报错，应改为捕获指针或下标。只能移动，不能复制。
+ */
+class InlineTask {
+public:
+    static constexpr size_t CAPACITY = 40; // 可存放5个指针大小的捕获，与环形队列槽的序号、入队时刻一起恰好占一个缓存行
+
+    InlineTask() noexcept
+        : m_ops(nullptr)
+    {
+    }
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineTask>::value>>
+    InlineTask(F&& func) // 允许由lambda表达式隐式构造
+    {
+        using Func = std::decay_t<F>;
+        static_assert(sizeof(Func) <= CAPACITY, "InlineTask: capture is too large, capture pointers instead");
+        static_assert(alignof(Func) <= alignof(void*), "InlineTask: capture is over-aligned");
+        static_assert(std::is_nothrow_move_constructible<Func>::value, "InlineTask: capture must be nothrow movable");
+        new (m_storage) Func(std::forward<F>(func));
+        m_ops = GetOps<Func>();
+    }
+
+    InlineTask(InlineTask&& other) noexcept
+        : m_ops(other.m_ops)
+    {
+        if (m_ops) {
+            m_ops->move(m_storage, other.m_storage);
+            other.m_ops = nullptr;
+        }
+    }
+
+    InlineTask& operator=(InlineTask&& other) noexcept
+    {
+        if (this != &other) {
+            Reset();
+            m_ops = other.m_ops;
+            if (m_ops) {
+                m_ops->move(m_storage, other.m_storage);
+                other.m_ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { Reset(); }
+
+    void operator()()
+    {
+        assert(m_ops);
+        m_ops->invoke(m_storage);
+    }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+private:
+    /* 按存放的类型生成的操作表，代替虚函数 */
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src); // 移动构造到dst并析构src
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Func>
+    static const Ops* GetOps()
+    {
+        static const Ops ops = {
+            [](void* storage) { (*static_cast<Func*>(storage))(); },
+            [](void* dst, void* src) {
+                new (dst) Func(std::move(*static_cast<Func*>(src)));
+                static_cast<Func*>(src)->~Func();
+            },
+            [](void* storage) { static_cast<Func*>(storage)->~Func(); },
+        };
+        return &ops;
+    }
+
+    void Reset()
+    {
+        if (m_ops) {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    alignas(void*) unsigned char m_storage[CAPACITY]; // 只按指针对齐，使InlineTask可与其他8字节字段紧凑排列
+    const Ops* m_ops;
+};
+
+#endif // _INLINE_TASK_H_
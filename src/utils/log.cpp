@@ -1,4 +1,6 @@
 #include "log.h"
+#include "affinity.h"
+#include "coarse_clock.h"
 #include <cassert>
 #include <memory>
 
@@ -58,11 +60,14 @@ void Log::Init(int max_queue_capacity, const char* path, const char* suffix)
 
 void Log::WriteLog(int level, const char* format, ...)
 {
-    struct timeval now = { 0, 0 };
-    gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm* sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
+    struct timespec now = CoarseClock::WallTime(); // 事件循环线程中不再有时间相关的系统调用
+    static thread_local time_t lastSec = -1;
+    static thread_local struct tm lastTime;
+    if (now.tv_sec != lastSec) { // 同一秒内复用上次localtime的结果
+        localtime_r(&now.tv_sec, &lastTime);
+        lastSec = now.tv_sec;
+    }
+    struct tm t = lastTime;
     va_list vaList;
 
     if (m_today != t.tm_mday || (m_line_count && (m_line_count % MAX_LOG_LINES == 0))) {
@@ -95,7 +100,7 @@ void Log::WriteLog(int level, const char* format, ...)
         m_line_count++;
         int n = snprintf(m_buff.GetWritePtr(), 128, "%04d-%02d-%02d %02d:%02d:%02d.%06ld ", // 添加年月日时分秒微秒———"2022-12-29 19:08:23.406500"
             t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-            t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
+            t.tm_hour, t.tm_min, t.tm_sec, now.tv_nsec / 1000);
         m_buff.AddWritePos(n);
         switch (level) { // 添加日志等级———"2022-12-29 19:08:23.406539 [debug]: "
         case 0:
@@ -136,6 +141,13 @@ void Log::WriteLog(int level, const char* format, ...)
     }
 }
 
+void Log::SetCpu(int cpu)
+{
+    if (m_write_thread) {
+        CpuAffinity::Pin(m_write_thread->native_handle(), cpu);
+    }
+}
+
 void Log::AsyncWrite()
 {
     std::string str = "";
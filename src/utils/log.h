@@ -39,6 +39,11 @@ public:
      */
     void WriteLog(int level, const char* format, ...);
 
+    /**
+     * 把异步写线程绑定到cpu上，cpu<0时不绑核
+     */
+    void SetCpu(int cpu);
+
 private:
     Log()
         : m_line_count(0)
@@ -0,0 +1,103 @@
+#ifndef _MPMC_RING_H_
+#define _MPMC_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * 定长无锁多生产者多消费者环形队列(Vyukov算法)：每个槽带一个序号，seq等于入队位置时可写，等于入队位置+1时可读，
+ * 入队、出队各用一次CAS抢占位置，不加锁。容量向上取整为2的幂，满时TryPush失败，由调用者决定等待还是走其他路径。
+ */
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity)
+        : m_mask(0)
+        , m_enqueue_pos(0)
+        , m_dequeue_pos(0)
+    {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        m_cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        m_mask = size - 1;
+    }
+
+    /**
+     * 入队，成功时value被移入队列，队列满时返回false且value不变
+     */
+    bool TryPush(T& value)
+    {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) { // 该槽上一圈的元素还未被取走
+                return false;
+            } else {
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * 出队，队列空时返回false
+     */
+    bool TryPop(T& value)
+    {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) { // 该槽还未写入
+                return false;
+            } else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release); // 留给下一圈入队
+        return true;
+    }
+
+    /**
+     * 队列是否为空，并发时只是一个近似值
+     */
+    bool Empty() const
+    {
+        return m_enqueue_pos.load(std::memory_order_relaxed) == m_dequeue_pos.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Cell { // 每个槽独占缓存行，相邻槽的生产者、消费者不会伪共享
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueue_pos; // 入队与出队位置分属不同缓存行
+    alignas(64) std::atomic<size_t> m_dequeue_pos;
+};
+
+#endif // _MPMC_RING_H_
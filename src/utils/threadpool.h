@@ -1,90 +1,448 @@
 #ifndef _THREADPOOL_H
 #define _THREADPOOL_H
 
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <climits>
 #include <condition_variable>
-#include <functional>
+#include <cstdint>
+#include <linux/futex.h>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <sys/syscall.h>
 #include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "affinity.h"
+#include "coarse_clock.h"
+#include "inline_task.h"
+#include "log.h"
+#include "mpmc_ring.h"
 
 /**
- * 半同步/半反应堆线程池:内包含一个工作队列，主线程（线程池的创建者）往工作队列中插入任务，工作线程通过竞争来取得任务并执行它。
+ * 工作窃取(work-stealing)线程池：每个工作线程有自己的任务双端队列，各用一把只在本队列上竞争的锁。
+ * 非工作线程（各Reactor）添加的任务轮流投递到各工作线程的队列中，工作线程自己添加的任务放入自己的队列。
+ * 工作线程从自己队列的尾部取任务(LIFO，缓存更热)，自己的队列为空时从随机选中的其他队列头部窃取(FIFO)，都取不到时才休眠。
+ * 另有无锁环形队列模式：所有线程共用一个定长的MPMC环形队列(Vyukov算法，每个槽带序号)，空闲线程用futex实现的eventcount休眠，
+ * 没有线程休眠时AddTask不加锁也不做系统调用。
+ * 弹性模式在环形队列模式的基础上，线程数在[thread_count, max_threads]之间伸缩：任务排队超过grow_wait_ms时增加一个线程，
+ * 新增的线程空闲超过idle_timeout_ms后退出，扩缩次数等计数可由GetStats取得(示例的/status应答会输出)。
+ * 任务以InlineTask的形式直接存放在队列节点中，投递任务不申请堆内存。
  */
 class ThreadPool {
 public:
+    enum Mode {
+        MODE_WORK_STEALING, // 每线程一个队列，工作窃取
+        MODE_MPMC_RING, // 共用一个无锁定长环形队列
+        MODE_ELASTIC, // 共用环形队列，线程数随排队时间伸缩
+    };
+
+    /* 弹性模式的计数 */
+    struct Stats {
+        size_t threads; // 当前线程数
+        size_t peak; // 历史最大线程数
+        size_t grows; // 扩容次数
+        size_t retires; // 空闲退出次数
+    };
+
     /**
-     * thread_count：线程池中线程的数量
+     * thread_count：线程池中线程的数量，mode：任务队列的组织方式，
+     * cpus：第i个工作线程绑定到cpus[i % cpus.size()]上，为空时不绑核，ring_capacity：环形队列的容量，向上取整为2的幂
      */
-    explicit ThreadPool(size_t thread_count = 8)
-        : m_stop(false)
+    explicit ThreadPool(size_t thread_count = 8, Mode mode = MODE_WORK_STEALING, const std::vector<int>& cpus = {},
+        size_t ring_capacity = 65536)
+        : m_mode(mode)
+        , m_stop(false)
+        , m_pending(0)
+        , m_idle(0)
+        , m_next(0)
+        , m_epoch(0)
+        , m_waiters(0)
+        , m_ready(0)
+        , m_cpus(cpus)
+        , m_max_threads(thread_count)
+        , m_grow_wait_ms(10)
+        , m_idle_timeout_ms(30000)
+        , m_threads(thread_count)
+        , m_peak(thread_count)
+        , m_grows(0)
+        , m_retires(0)
+        , m_extra_live(0)
+        , m_last_pop_ms(CoarseClock::NowMs())
+        , m_last_grow_ms(0)
     {
         assert(thread_count > 0);
+        if (m_mode != MODE_WORK_STEALING) {
+            m_ring = std::make_unique<MpmcRing<RingTask>>(ring_capacity);
+        } else {
+            m_queues.resize(thread_count); // 各队列由工作线程绑核后自己创建，使其内存位于该线程所在的NUMA节点
+        }
         for (size_t i = 0; i < thread_count; i++) { // 创建thread_count个线程
-            m_workers.emplace_back( // 线程加入workers数组
-                std::thread( // 新建的线程对象
-                    [this] { // 使用lambda表达式定义线程执行的run函数
-                        // std::unique_lock<std::mutex> locker(this->m_queue_mutex);
-                        while (true) { // 死循环
-                            std::function<void()> task;
-
-                            {
-                                std::unique_lock<std::mutex> locker(this->m_queue_mutex); // 加锁，RAII风格的锁可以保证当该lambda表达式退出时，解锁
-                                this->m_condition.wait(locker,
-                                    [this] { return this->m_stop || !this->m_tasks.empty(); }); // 用lambda表达式定义判断任务队列是否有任务的谓词
-                                if (this->m_stop && this->m_tasks.empty())
-                                    return;
-                                task = std::move(this->m_tasks.front()); // move取出任务更高效
-                                this->m_tasks.pop();
-                            }
-
-                            task(); // 执行任务
-                        }
-
-                        // 另一版本的run函数
-                        // if (!this->m_tasks.empty()) { // 若工作队列有任务
-                        //     auto task = std::move(this->m_tasks.front());
-                        //     this->m_tasks.pop();
-                        //     locker.unlock(); // 对任务队列操作结束释放锁
-                        //     task(); // 执行函数
-                        //     locker.lock(); // 函数执行完毕，重新加锁
-                        // } else if (this->m_stop)
-                        //     break;
-                        // else
-                        //     this->m_condition.wait(locker); // 线程阻塞等待解锁被唤醒
-                    }));
-            m_workers.back().detach(); // 线程分离式启动，主线程不用等待子线程结束
+            int cpu = CpuAffinity::Pick(cpus, i);
+            m_workers.emplace_back([this, i, cpu, thread_count] {
+                CpuAffinity::PinSelf(cpu);
+                if (m_mode == MODE_WORK_STEALING) {
+                    m_queues[i] = std::make_unique<WorkQueue>();
+                }
+                {
+                    std::unique_lock<std::mutex> locker(m_sleep_mutex); // 所有队列创建完毕之后才能互相窃取
+                    if (++m_ready == thread_count) {
+                        m_condition.notify_all();
+                    } else {
+                        m_condition.wait(locker, [this, thread_count] { return m_ready == thread_count; });
+                    }
+                }
+                if (m_mode != MODE_WORK_STEALING) {
+                    RunRing(false);
+                } else {
+                    Run(i);
+                }
+            });
         }
+        std::unique_lock<std::mutex> locker(m_sleep_mutex); // 等所有队列创建完毕才能投递任务
+        m_condition.wait(locker, [this, thread_count] { return m_ready == thread_count; });
     }
     ~ThreadPool()
     {
         {
-            std::lock_guard<std::mutex> locker(m_queue_mutex);
+            std::lock_guard<std::mutex> locker(m_sleep_mutex);
             m_stop = true;
         }
         m_condition.notify_all();
+        m_epoch.fetch_add(1);
+        FutexWake(INT_MAX);
+        for (auto& worker : m_workers) { // 等待工作线程执行完剩余任务后退出，线程访问的队列随线程池一起析构
+            worker.join();
+        }
+        std::unique_lock<std::mutex> locker(m_sleep_mutex); // 弹性模式新增的线程是分离的，等它们全部退出
+        m_condition.wait(locker, [this] { return m_extra_live == 0; });
     };
 
     /**
-     * 往工作队列中添加任务，唤醒一个线程，task应是一个右值，匿名函数，lambda表达式
+     * 设置弹性模式的参数，需在投递任务之前调用，其他模式下无效。
+     * max_threads：最大线程数，grow_wait_ms：任务排队超过该时间(ms)时扩容，idle_timeout_ms：新增线程空闲超过该时间(ms)后退出
+     */
+    void SetElastic(size_t max_threads, int grow_wait_ms, int idle_timeout_ms)
+    {
+        m_max_threads = std::max(max_threads, m_threads.load());
+        m_grow_wait_ms = std::max(grow_wait_ms, 1);
+        m_idle_timeout_ms = std::max(idle_timeout_ms, 1);
+    }
+
+    Stats GetStats() const
+    {
+        return { m_threads.load(), m_peak.load(), m_grows.load(), m_retires.load() };
+    }
+
+    /**
+     * 往工作队列中添加任务，必要时唤醒一个空闲线程，task应是一个右值，匿名函数，lambda表达式，捕获不能超过InlineTask::CAPACITY字节
      */
     template <typename T>
     void AddTask(T&& task)
     {
+        InlineTask func(std::forward<T>(task)); // 捕获过大时在此编译报错
+        if (m_mode != MODE_WORK_STEALING) {
+            int64_t now = m_mode == MODE_ELASTIC ? CoarseClock::NowMs() : 0;
+            while (!TryPush(func, now)) { // 队列满时等待工作线程取走任务，容量不小于最大连接数时不会发生
+                if (t_pool == this) { // 工作线程自己等待可能导致所有线程互相等待，直接执行
+                    func();
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst); // 与RunRing中的m_waiters配合，保证不会丢失唤醒
+            if (m_waiters.load(std::memory_order_relaxed) > 0) {
+                m_epoch.fetch_add(1);
+                FutexWake(1);
+            } else if (m_mode == MODE_ELASTIC) { // 没有空闲线程，检查是否需要扩容
+                CheckGrow(now, 0);
+            }
+            return;
+        }
+        size_t index = t_pool == this ? t_index : m_next.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
         {
-            std::lock_guard<std::mutex> locker(m_queue_mutex); // 加入队列时加锁
-            m_tasks.emplace(std::forward<T>(task)); // 将任务添加到队列中
+            std::lock_guard<std::mutex> locker(m_queues[index]->mutex);
+            m_queues[index]->push_back(std::move(func));
+        }
+        m_pending.fetch_add(1); // 与Run中的m_idle配合，保证不会丢失唤醒
+        if (m_idle.load() > 0) {
+            std::lock_guard<std::mutex> locker(m_sleep_mutex);
+            m_condition.notify_one();
         }
-        m_condition.notify_one(); // 唤醒一个线程
     }
 
 private:
+    /**
+     * 工作线程的任务双端队列：容量为2的幂的循环数组，只增不减，达到稳定大小后不再申请内存（std::deque会反复申请、释放内存块）
+     */
+    struct alignas(64) WorkQueue { // 按缓存行对齐，避免不同线程的队列伪共享
+        std::mutex mutex;
+        std::vector<InlineTask> tasks = std::vector<InlineTask>(64);
+        size_t head = 0; // 队头下标，单调递增，取模后使用
+        size_t count = 0;
+
+        bool empty() const { return count == 0; }
+        void push_back(InlineTask&& task)
+        {
+            if (count == tasks.size()) { // 满了，按原顺序搬到两倍大小的数组中
+                std::vector<InlineTask> bigger(tasks.size() * 2);
+                for (size_t i = 0; i < count; i++) {
+                    bigger[i] = std::move(tasks[(head + i) & (tasks.size() - 1)]);
+                }
+                tasks.swap(bigger);
+                head = 0;
+            }
+            tasks[(head + count++) & (tasks.size() - 1)] = std::move(task);
+        }
+        InlineTask pop_back() { return std::move(tasks[(head + --count) & (tasks.size() - 1)]); }
+        InlineTask pop_front()
+        {
+            count--;
+            return std::move(tasks[head++ & (tasks.size() - 1)]);
+        }
+    };
+
+    /**
+     * 工作线程的执行函数，index为该线程自己的队列下标
+     */
+    void Run(size_t index)
+    {
+        t_pool = this;
+        t_index = index;
+        uint32_t seed = static_cast<uint32_t>(index) * 2654435761u + 1; // 选择窃取对象的随机数种子
+        while (true) {
+            InlineTask task;
+            if (PopLocal(index, task) || Steal(index, seed, task)) {
+                m_pending.fetch_sub(1, std::memory_order_relaxed);
+                task(); // 执行任务
+                continue;
+            }
+            if (m_pending.load() > 0) { // 任务正在投递或所在队列正被占用，让出CPU后重试
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> locker(m_sleep_mutex);
+            m_idle.fetch_add(1);
+            m_condition.wait(locker, [this] { return m_stop || m_pending.load() > 0; });
+            m_idle.fetch_sub(1);
+            if (m_stop && m_pending.load() == 0)
+                return;
+        }
+    }
+
+    /**
+     * 从自己队列的尾部取出最近加入的任务
+     */
+    bool PopLocal(size_t index, InlineTask& task)
+    {
+        WorkQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> locker(queue.mutex);
+        if (queue.empty())
+            return false;
+        task = queue.pop_back(); // move取出任务更高效
+        return true;
+    }
+
+    /**
+     * 从随机选中的队列开始依次尝试，从其头部窃取最早加入的任务
+     */
+    bool Steal(size_t index, uint32_t& seed, InlineTask& task)
+    {
+        size_t n = m_queues.size();
+        seed ^= seed << 13; // xorshift
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        size_t start = seed % n;
+        for (size_t i = 0; i < n; i++) {
+            size_t victim = (start + i) % n;
+            if (victim == index)
+                continue;
+            WorkQueue& queue = *m_queues[victim];
+            std::unique_lock<std::mutex> locker(queue.mutex, std::try_to_lock); // 正被占用的队列先跳过
+            if (!locker.owns_lock() || queue.empty())
+                continue;
+            task = queue.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    struct RingTask { // 环形队列中的任务，与槽的序号一起恰好占一个缓存行
+        int64_t stamp; // 入队时刻(ms)，弹性模式下用于计算排队时间
+        InlineTask task;
+    };
+
+    /**
+     * 无锁入队，now为入队时刻，队列满时返回false且task不变
+     */
+    bool TryPush(InlineTask& task, int64_t now)
+    {
+        RingTask item { now, std::move(task) };
+        if (m_ring->TryPush(item)) {
+            return true;
+        }
+        task = std::move(item.task);
+        return false;
+    }
+
+    /**
+     * 无锁出队，stamp为任务的入队时刻，队列空时返回false
+     */
+    bool TryPop(InlineTask& task, int64_t& stamp)
+    {
+        RingTask item;
+        if (!m_ring->TryPop(item)) {
+            return false;
+        }
+        task = std::move(item.task);
+        stamp = item.stamp;
+        return true;
+    }
+
+    /**
+     * 环形队列模式下工作线程的执行函数，extra为弹性模式下新增的线程，空闲超时后退出
+     */
+    void RunRing(bool extra)
+    {
+        t_pool = this;
+        InlineTask task;
+        int64_t stamp;
+        while (true) {
+            if (TryPop(task, stamp)) {
+                RunTask(task, stamp);
+                continue;
+            }
+            /* eventcount：先记下epoch并登记为等待者，再检查一次队列，期间有新任务时epoch会改变，futex不会睡下去 */
+            uint32_t epoch = m_epoch.load();
+            m_waiters.fetch_add(1);
+            if (TryPop(task, stamp)) {
+                m_waiters.fetch_sub(1);
+                RunTask(task, stamp);
+                continue;
+            }
+            if (m_stop) {
+                m_waiters.fetch_sub(1);
+                break;
+            }
+            struct timespec idle = { m_idle_timeout_ms / 1000, (m_idle_timeout_ms % 1000) * 1000000L };
+            long ret = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, epoch,
+                extra ? &idle : nullptr, nullptr, 0);
+            m_waiters.fetch_sub(1);
+            if (extra && ret == -1 && errno == ETIMEDOUT) { // 空闲超时
+                if (TryPop(task, stamp)) {
+                    RunTask(task, stamp);
+                    continue;
+                }
+                size_t threads = --m_threads;
+                m_retires++;
+                LOG_INFO("ThreadPool shrink to %zu threads, grows: %zu, retires: %zu", threads, m_grows.load(), m_retires.load());
+                break;
+            }
+        }
+        if (extra) {
+            std::lock_guard<std::mutex> locker(m_sleep_mutex);
+            if (--m_extra_live == 0) {
+                m_condition.notify_all();
+            }
+        }
+    }
+
+    void RunTask(InlineTask& task, int64_t stamp)
+    {
+        if (m_mode == MODE_ELASTIC) {
+            int64_t now = CoarseClock::NowMs();
+            m_last_pop_ms.store(now, std::memory_order_relaxed);
+            if (now - stamp >= m_grow_wait_ms) { // 任务排队过久
+                CheckGrow(now, now - stamp);
+            }
+        }
+        task(); // 执行任务
+        task = InlineTask(); // 及时析构捕获的对象
+    }
+
+    /**
+     * 弹性模式下判断是否增加一个线程，waited为刚取出的任务的排队时间，由AddTask调用时为0。
+     * 有空闲线程时不扩容；AddTask时若队列非空且已有grow_wait_ms没有任务被取走，说明所有线程都被阻塞，也扩容；每grow_wait_ms最多扩容一次
+     */
+    void CheckGrow(int64_t now, int64_t waited)
+    {
+        if (m_waiters.load(std::memory_order_relaxed) > 0 || m_threads.load(std::memory_order_relaxed) >= m_max_threads) {
+            return;
+        }
+        if (waited < m_grow_wait_ms
+            && (m_ring->Empty()
+                || now - m_last_pop_ms.load(std::memory_order_relaxed) < m_grow_wait_ms)) {
+            return;
+        }
+        int64_t last = m_last_grow_ms.load();
+        if (now - last < m_grow_wait_ms || !m_last_grow_ms.compare_exchange_strong(last, now)) {
+            return;
+        }
+        size_t threads = m_threads.load();
+        do {
+            if (threads >= m_max_threads)
+                return;
+        } while (!m_threads.compare_exchange_weak(threads, threads + 1));
+        size_t peak = m_peak.load();
+        while (peak < threads + 1 && !m_peak.compare_exchange_weak(peak, threads + 1)) { }
+        m_grows++;
+        {
+            std::lock_guard<std::mutex> locker(m_sleep_mutex);
+            m_extra_live++;
+        }
+        int cpu = CpuAffinity::Pick(m_cpus, threads);
+        std::thread([this, cpu] {
+            if (cpu >= 0) {
+                CpuAffinity::PinSelf(cpu);
+            } else { // 扩容由Reactor或工作线程触发，不绑核时不应继承它们的绑核，否则新线程与触发者挤在同一个cpu上
+                CpuAffinity::ResetSelf();
+            }
+            RunRing(true);
+        }).detach();
+        LOG_INFO("ThreadPool grow to %zu threads, grows: %zu, retires: %zu", threads + 1, m_grows.load(), m_retires.load());
+    }
+
+    void FutexWake(int count)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+    }
+
+    const Mode m_mode;
     std::vector<std::thread> m_workers; // 线程数组
-    std::queue<std::function<void()>> m_tasks; // 任务队列
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // 每个工作线程的任务队列
 
-    std::mutex m_queue_mutex; // 互斥锁
+    std::mutex m_sleep_mutex; // 仅用于空闲线程休眠
     std::condition_variable m_condition; // 条件变量
-    bool m_stop; // 停止或开始任务
+    std::atomic<bool> m_stop; // 停止或开始任务
+    std::atomic<long> m_pending; // 所有队列中尚未取出的任务数，投递与窃取并发时可能短暂为负
+    std::atomic<size_t> m_idle; // 正在休眠或准备休眠的线程数
+    std::atomic<size_t> m_next; // 非工作线程投递任务时轮转的队列下标
+
+    std::unique_ptr<MpmcRing<RingTask>> m_ring; // 环形队列模式下共用的任务队列
+    alignas(64) std::atomic<uint32_t> m_epoch; // eventcount的计数，futex在其上等待
+    std::atomic<int> m_waiters; // 登记等待的线程数，为0时AddTask不需要唤醒
+    size_t m_ready; // 已完成初始化的工作线程数
+
+    /* 下面的成员用于弹性模式 */
+    const std::vector<int> m_cpus; // 新增线程也按此绑核
+    size_t m_max_threads;
+    int m_grow_wait_ms;
+    int m_idle_timeout_ms;
+    std::atomic<size_t> m_threads; // 当前线程数
+    std::atomic<size_t> m_peak;
+    std::atomic<size_t> m_grows;
+    std::atomic<size_t> m_retires;
+    size_t m_extra_live; // 尚未退出的新增线程数，由m_sleep_mutex保护
+    alignas(64) std::atomic<int64_t> m_last_pop_ms; // 最近一次取出任务的时刻
+    std::atomic<int64_t> m_last_grow_ms; // 最近一次扩容的时刻
+
+    static thread_local ThreadPool* t_pool; // 当前线程所属的线程池，非工作线程为nullptr
+    static thread_local size_t t_index; // 当前工作线程的队列下标
 };
 
+inline thread_local ThreadPool* ThreadPool::t_pool = nullptr;
+inline thread_local size_t ThreadPool::t_index = 0;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "time_wheel.h"
+#include <algorithm>
+#include <climits>
+
+TimeWheel::TimeWheel()
+    : m_heads(SLOT_COUNT + 1, -1)
+    , m_bitmap0 {}
+    , m_bitmapN {}
+    , m_current(NowMs())
+    , m_count(0)
+{
+    m_nodes.reserve(64);
+}
+
+int64_t TimeWheel::NowMs()
+{
+    return CoarseClock::NowMs(); // 事件循环线程中为本轮Wait返回时缓存的时间
+}
+
+int TimeWheel::GetSlot(int64_t expires) const
+{
+    int64_t idx = expires - m_current;
+    if (idx < 0) { // 已经超时的节点挂到下一个待处理的槽
+        return static_cast<int>(m_current & (WHEEL0_SIZE - 1));
+    }
+    if (idx < WHEEL0_SIZE) {
+        return static_cast<int>(expires & (WHEEL0_SIZE - 1));
+    }
+    for (int level = 1; level < LEVELS; level++) {
+        int shift = WHEEL0_BITS + level * WHEELN_BITS;
+        if (idx < (1LL << shift) || level == LEVELS - 1) {
+            int index = static_cast<int>((expires >> (shift - WHEELN_BITS)) & (WHEELN_SIZE - 1));
+            return WHEEL0_SIZE + (level - 1) * WHEELN_SIZE + index;
+        }
+    }
+    return -1; // 不会到达
+}
+
+void TimeWheel::Link(int id, int slot)
+{
+    Node& node = m_nodes[id];
+    node.slot = slot;
+    node.prev = -1;
+    node.next = m_heads[slot];
+    if (node.next != -1) {
+        m_nodes[node.next].prev = id;
+    }
+    m_heads[slot] = id;
+    if (slot < WHEEL0_SIZE) {
+        m_bitmap0[slot / 64] |= 1ULL << (slot % 64);
+    } else if (slot < SLOT_COUNT) {
+        int level = (slot - WHEEL0_SIZE) / WHEELN_SIZE;
+        m_bitmapN[level] |= 1ULL << ((slot - WHEEL0_SIZE) % WHEELN_SIZE);
+    }
+    m_count++;
+}
+
+void TimeWheel::Unlink(int id)
+{
+    Node& node = m_nodes[id];
+    int slot = node.slot;
+    assert(slot != -1);
+    if (node.prev != -1) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_heads[slot] = node.next;
+    }
+    if (node.next != -1) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    if (m_heads[slot] == -1) { // 槽空了，清除位图
+        if (slot < WHEEL0_SIZE) {
+            m_bitmap0[slot / 64] &= ~(1ULL << (slot % 64));
+        } else if (slot < SLOT_COUNT) {
+            int level = (slot - WHEEL0_SIZE) / WHEELN_SIZE;
+            m_bitmapN[level] &= ~(1ULL << ((slot - WHEEL0_SIZE) % WHEELN_SIZE));
+        }
+    }
+    node.slot = -1;
+    node.prev = node.next = -1;
+    m_count--;
+}
+
+void TimeWheel::add(int id, int timeout, const TimeoutCallBack& cb)
+{
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= m_nodes.size()) {
+        m_nodes.resize(id + 1, { 0, nullptr, -1, -1, -1 });
+    }
+    Node& node = m_nodes[id];
+    if (node.slot != -1) { /* 已有结点：先摘下 */
+        Unlink(id);
+    }
+    node.expires = NowMs() + std::min<int64_t>(std::max(timeout, 0), MAX_TIMEOUT);
+    node.cb = cb;
+    Link(id, GetSlot(node.expires));
+}
+
+void TimeWheel::adjust(int id, int timeout)
+{
+    /* 调整指定id的结点 */
+    assert(id >= 0 && static_cast<size_t>(id) < m_nodes.size() && m_nodes[id].slot != -1);
+    Unlink(id);
+    Node& node = m_nodes[id];
+    node.expires = NowMs() + std::min<int64_t>(std::max(timeout, 0), MAX_TIMEOUT);
+    Link(id, GetSlot(node.expires));
+}
+
+void TimeWheel::clear()
+{
+    m_nodes.clear();
+    std::fill(m_heads.begin(), m_heads.end(), -1);
+    std::fill(std::begin(m_bitmap0), std::end(m_bitmap0), 0);
+    std::fill(std::begin(m_bitmapN), std::end(m_bitmapN), 0);
+    m_count = 0;
+}
+
+int TimeWheel::Cascade(int level, int index)
+{
+    int slot = WHEEL0_SIZE + (level - 1) * WHEELN_SIZE + index;
+    while (m_heads[slot] != -1) { // 按剩余时间重新挂入低层
+        int id = m_heads[slot];
+        Unlink(id);
+        Link(id, GetSlot(m_nodes[id].expires));
+    }
+    return index;
+}
+
+void TimeWheel::Expire(int index)
+{
+    /* 先整体移入暂存链表，回调中新加入的节点不会在本次被执行 */
+    while (m_heads[index] != -1) {
+        int id = m_heads[index];
+        Unlink(id);
+        Link(id, PENDING_SLOT);
+    }
+    while (m_heads[PENDING_SLOT] != -1) {
+        int id = m_heads[PENDING_SLOT];
+        Unlink(id);
+        TimeoutCallBack cb = std::move(m_nodes[id].cb); // 回调中可能重新add同一个id
+        cb();
+    }
+}
+
+int TimeWheel::NextWheel0Slot(int from) const
+{
+    for (int word = from / 64; word < WHEEL0_SIZE / 64; word++) {
+        uint64_t bits = m_bitmap0[word];
+        if (word == from / 64) {
+            bits &= ~0ULL << (from % 64); // 屏蔽from之前的槽
+        }
+        if (bits) {
+            return word * 64 + __builtin_ctzll(bits);
+        }
+    }
+    return WHEEL0_SIZE;
+}
+
+void TimeWheel::tick()
+{
+    /* 清除超时结点 */
+    int64_t now = NowMs();
+    while (m_current <= now) {
+        if (m_count == 0) { // 没有节点，直接追上当前时间
+            m_current = now + 1;
+            break;
+        }
+        int index = static_cast<int>(m_current & (WHEEL0_SIZE - 1));
+        if (index == 0) { // 第0层转完一圈，逐层cascade
+            if (Cascade(1, (m_current >> WHEEL0_BITS) & (WHEELN_SIZE - 1)) == 0
+                && Cascade(2, (m_current >> (WHEEL0_BITS + WHEELN_BITS)) & (WHEELN_SIZE - 1)) == 0) {
+                Cascade(3, (m_current >> (WHEEL0_BITS + 2 * WHEELN_BITS)) & (WHEELN_SIZE - 1));
+            }
+        } else {
+            int next = NextWheel0Slot(index);
+            if (next != index) { // 跳过空槽，最多跳到本圈结束处，以免漏掉cascade
+                m_current = std::min(m_current - index + next, now + 1);
+                continue;
+            }
+        }
+        m_current++; // 先前进，回调中add的已超时节点会挂到下一个槽
+        Expire(index);
+    }
+}
+
+int TimeWheel::GetNextTick()
+{
+    tick();
+    if (m_count == 0) {
+        return -1;
+    }
+    /* 下一次需要处理的时刻：第0层最近的非空槽，或高层最近的非空槽被cascade的时刻 */
+    int64_t due = LLONG_MAX;
+    int index = static_cast<int>(m_current & (WHEEL0_SIZE - 1));
+    int next = NextWheel0Slot(index);
+    if (next < WHEEL0_SIZE) {
+        due = m_current - index + next;
+    } else if ((next = NextWheel0Slot(0)) < index) { // 下一圈的槽
+        due = m_current - index + WHEEL0_SIZE + next;
+    }
+    for (int level = 1; level < LEVELS; level++) {
+        uint64_t bits = m_bitmapN[level - 1];
+        if (!bits) {
+            continue;
+        }
+        int shift = WHEEL0_BITS + (level - 1) * WHEELN_BITS;
+        int64_t period = (m_current - 1) >> shift; // 最后处理过的时刻所在的周期，其后的周期都还未cascade
+        int rot = static_cast<int>((period + 1) & (WHEELN_SIZE - 1)); // 从下一个槽起循环查找
+        uint64_t rotated = rot ? (bits >> rot) | (bits << (WHEELN_SIZE - rot)) : bits;
+        int64_t distance = __builtin_ctzll(rotated) + 1;
+        due = std::min(due, (period + distance) << shift);
+    }
+    int64_t res = due - NowMs();
+    return static_cast<int>(std::max<int64_t>(std::min<int64_t>(res, INT_MAX), 0));
+}
@@ -0,0 +1,96 @@
+#ifndef _TIME_WHEEL_H_
+#define _TIME_WHEEL_H_
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "coarse_clock.h"
+#include "timer.h"
+
+/* 分层时间轮：与时间堆HeapTimer接口一致，add/adjust/超时删除均为O(1)，且不需要哈希表。 */
+
+/**
+ * 分层时间轮(hierarchical timing wheel)，粒度为1ms，共4层：第0层256个槽，每槽1ms；第1~3层各64个槽，每槽为下一层转一圈的时间，
+ * 最长可表示2^26ms(约18.6小时)，更长的超时按最长处理。
+ * 节点以id为下标存放在数组中，每个槽是一个以数组下标串起来的双向链表，add/adjust只需摘链、挂链。
+ * 第0层每走过一个槽即执行该槽的超时回调；第0层转完一圈时，把第1层下一个槽中的节点按剩余时间重新挂到低层(cascade)，依此类推。
+ */
+class TimeWheel {
+public:
+    TimeWheel();
+    ~TimeWheel() { clear(); }
+
+    /**
+     * 调整已有节点的超时时间为timeout(ms)之后
+     */
+    void adjust(int id, int timeout);
+    /**
+     * 添加节点，id已存在时更新其超时时间与回调
+     */
+    void add(int id, int timeout, const TimeoutCallBack& cb);
+
+    void clear();
+    /**
+     * 执行所有已超时节点的回调
+     */
+    void tick();
+    /**
+     * 先执行已超时的回调，再返回距离下一次需要处理的时间(ms)，没有节点时返回-1
+     */
+    int GetNextTick();
+
+    size_t size() const { return m_count; }
+
+private:
+    static const int WHEEL0_BITS = 8;
+    static const int WHEELN_BITS = 6;
+    static const int WHEEL0_SIZE = 1 << WHEEL0_BITS; // 第0层槽数
+    static const int WHEELN_SIZE = 1 << WHEELN_BITS; // 第1~3层槽数
+    static const int LEVELS = 4;
+    static const int SLOT_COUNT = WHEEL0_SIZE + (LEVELS - 1) * WHEELN_SIZE;
+    static const int PENDING_SLOT = SLOT_COUNT; // 正在执行回调的节点暂存的链表
+    static constexpr int64_t MAX_TIMEOUT = (1LL << (WHEEL0_BITS + (LEVELS - 1) * WHEELN_BITS)) - 1;
+
+    struct Node {
+        int64_t expires; // 超时时刻(ms)
+        TimeoutCallBack cb; // 超时回调函数
+        int prev; // 链表中前后节点的id，-1代表没有
+        int next;
+        int slot; // 所在的槽，-1代表节点不在时间轮中
+    };
+
+    /**
+     * 当前时刻(ms)，取粗粒度单调时钟
+     */
+    static int64_t NowMs();
+    /**
+     * 根据超时时刻计算节点应挂入的槽
+     */
+    int GetSlot(int64_t expires) const;
+    void Link(int id, int slot);
+    void Unlink(int id);
+    /**
+     * 把第level层第index个槽中的节点重新挂入时间轮，返回index
+     */
+    int Cascade(int level, int index);
+    /**
+     * 执行第0层第index个槽中全部节点的回调
+     */
+    void Expire(int index);
+    /**
+     * 从第0层第from个槽开始(不跨越本圈)找下一个非空槽，没有时返回WHEEL0_SIZE
+     */
+    int NextWheel0Slot(int from) const;
+
+    std::vector<Node> m_nodes; // 以id为下标
+    std::vector<int> m_heads; // 每个槽链表的头节点id
+    uint64_t m_bitmap0[WHEEL0_SIZE / 64]; // 第0层非空槽位图
+    uint64_t m_bitmapN[LEVELS - 1]; // 第1~3层非空槽位图
+    int64_t m_current; // 下一个待处理的时刻，此前的时刻都已处理过
+    size_t m_count; // 时间轮中的节点数
+};
+
+#endif // _TIME_WHEEL_H_
@@ -4,7 +4,7 @@
  * 下滤：将当前节点与其左、右子节点相比，如果当前节点的值比其中一个（或两个）子节点的值大，就把当前节点与两个子节点中较小的那个交换，
  *      继续前面的比较，直到当前节点的值比两个子节点的值都小为止。此时，便符合最小堆的定义。
  */
-bool Timer::siftdown_(size_t index, size_t n)
+bool HeapTimer::siftdown_(size_t index, size_t n)
 { // 从index到n之间进行下虑
     assert(index >= 0 && index < heap_.size());
     assert(n >= 0 && n <= heap_.size());
@@ -26,20 +26,19 @@ bool Timer::siftdown_(size_t index, size_t n)
  * 上滤：将当前节点与其父节点相比，如果当前节点的值比较小，就把当前节点与父节点交换，
  *      继续前面的比较，直到当前节点的值比父节点的值大为止。此时，便符合最小堆的定义。
  */
-void Timer::siftup_(size_t i)
+void HeapTimer::siftup_(size_t i)
 {
     assert(i >= 0 && i < heap_.size());
-    size_t j = (i - 1) / 2;
-    while (j >= 0) {
+    while (i > 0) { // 到达堆顶时停止，size_t的i - 1会回绕
+        size_t j = (i - 1) / 2;
         if (heap_[j] < heap_[i]) {
             break;
         }
         SwapNode_(i, j);
         i = j;
-        j = (i - 1) / 2;
     }
 }
-void Timer::SwapNode_(size_t i, size_t j)
+void HeapTimer::SwapNode_(size_t i, size_t j)
 {
     assert(i >= 0 && i < heap_.size());
     assert(j >= 0 && j < heap_.size());
@@ -51,7 +50,7 @@ void Timer::SwapNode_(size_t i, size_t j)
 /**
  * 交换要删除节点和最后一个节点，然后进行下滤和上滤操作，最后删除数组尾部元素
  */
-void Timer::del_(size_t index)
+void HeapTimer::del_(size_t index)
 {
     /* 删除指定位置的结点 */
     assert(!heap_.empty() && index >= 0 && index < heap_.size());
@@ -70,7 +69,7 @@ void Timer::del_(size_t index)
     heap_.pop_back();
 }
 
-void Timer::adjust(int id, int timeout)
+void HeapTimer::adjust(int id, int timeout)
 {
     /* 调整指定id的结点 */
     assert(!heap_.empty() && ref_.count(id) > 0);
@@ -79,7 +78,7 @@ void Timer::adjust(int id, int timeout)
     siftdown_(ref_[id], heap_.size());
 }
 
-void Timer::add(int id, int timeOut, const TimeoutCallBack& cb)
+void HeapTimer::add(int id, int timeOut, const TimeoutCallBack& cb)
 {
     assert(id >= 0);
     size_t i;
@@ -98,13 +97,13 @@ void Timer::add(int id, int timeOut, const TimeoutCallBack& cb)
     }
 }
 
-void Timer::clear()
+void HeapTimer::clear()
 {
     ref_.clear();
     heap_.clear();
 }
 
-void Timer::tick()
+void HeapTimer::tick()
 {
     /* 清除超时结点 */
     if (heap_.empty()) {
@@ -121,7 +120,7 @@ void Timer::tick()
     }
 }
 
-int Timer::GetNextTick()
+int HeapTimer::GetNextTick()
 {
     tick();
     size_t res = -1;
@@ -134,7 +133,7 @@ int Timer::GetNextTick()
     return res;
 }
 
-void Timer::pop()
+void HeapTimer::pop()
 {
     assert(!heap_.empty());
     del_(0);
@@ -30,11 +30,14 @@ struct TimerNode {
     }
 };
 
-class Timer {
+/**
+ * 时间堆定时器：小顶堆 + 哈希表索引，add/adjust为O(logn)。连接的超时管理已改用TimeWheel，保留时间堆用于对比测试
+ */
+class HeapTimer {
 public:
-    Timer() { heap_.reserve(64); }
+    HeapTimer() { heap_.reserve(64); }
 
-    ~Timer() { clear(); }
+    ~HeapTimer() { clear(); }
 
     void adjust(int id, int newExpires);
 